@@ -0,0 +1,303 @@
+/*
+  ==============================================================================
+
+    AmbisonicPanner.cpp
+    Created: 17 Oct 2026 9:41:52pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "AmbisonicPanner.h"
+#include "geometric.hpp"
+
+
+//==============================================================================
+namespace
+{
+    // Weights each order so the energy is concentrated towards the source direction,
+    // which gives a tighter image than the plain mode-matched decode
+    std::vector<double> getMaxREWeights (int order)
+    {
+        const double x = std::cos (degreesToRadians (137.9) / (order + 1.51));
+        std::vector<double> weights ((size_t)order + 1);
+
+        // Legendre polynomials P_l(x)
+        double previous = 1.0, current = x;
+        weights[0] = 1.0;
+
+        if (order > 0)
+            weights[1] = x;
+
+        for (int l = 1; l < order; ++l)
+        {
+            const double next = ((2 * l + 1) * x * current - l * previous) / (l + 1);
+            previous = current;
+            current = next;
+            weights[(size_t)l + 1] = next;
+        }
+
+        return weights;
+    }
+
+    // Inverts a small square matrix in place with Gauss-Jordan elimination.
+    // Returns false if it is singular.
+    bool invertMatrix (std::vector<double>& m, int size)
+    {
+        std::vector<double> inverse ((size_t)(size * size), 0.0);
+
+        for (int i = 0; i < size; ++i)
+            inverse[(size_t)(i * size + i)] = 1.0;
+
+        for (int col = 0; col < size; ++col)
+        {
+            int pivot = col;
+
+            for (int row = col + 1; row < size; ++row)
+                if (std::abs (m[(size_t)(row * size + col)]) > std::abs (m[(size_t)(pivot * size + col)]))
+                    pivot = row;
+
+            if (std::abs (m[(size_t)(pivot * size + col)]) < 1.0e-12)
+                return false;
+
+            for (int i = 0; i < size; ++i)
+            {
+                std::swap (m[(size_t)(col * size + i)], m[(size_t)(pivot * size + i)]);
+                std::swap (inverse[(size_t)(col * size + i)], inverse[(size_t)(pivot * size + i)]);
+            }
+
+            const double scale = 1.0 / m[(size_t)(col * size + col)];
+
+            for (int i = 0; i < size; ++i)
+            {
+                m[(size_t)(col * size + i)] *= scale;
+                inverse[(size_t)(col * size + i)] *= scale;
+            }
+
+            for (int row = 0; row < size; ++row)
+            {
+                const double factor = m[(size_t)(row * size + col)];
+
+                if (row == col || factor == 0.0)
+                    continue;
+
+                for (int i = 0; i < size; ++i)
+                {
+                    m[(size_t)(row * size + i)] -= factor * m[(size_t)(col * size + i)];
+                    inverse[(size_t)(row * size + i)] -= factor * inverse[(size_t)(col * size + i)];
+                }
+            }
+        }
+
+        m = std::move (inverse);
+        return true;
+    }
+}
+
+//==============================================================================
+AmbisonicPanner::AmbisonicPanner (const std::vector<glm::vec3>& speakerPositions, int order, int maxBlockSize)
+    : mOrder (jlimit (minOrder, maxOrder, order)),
+      mNumSpeakers ((int)speakerPositions.size()),
+      mCentre (0.0f)
+{
+    const int numChannels = getNumChannels();
+    mBus.setSize (numChannels, jmax (1, maxBlockSize));
+    mDecoderMatrix.assign ((size_t)(mNumSpeakers * numChannels), 0.0f);
+
+    if (mNumSpeakers == 0)
+        return;
+
+    for (const auto& p : speakerPositions)
+        mCentre += p;
+
+    mCentre /= (float)mNumSpeakers;
+
+    // Y holds the harmonics of each speaker direction, one column per speaker
+    std::vector<double> y ((size_t)(numChannels * mNumSpeakers));
+    std::vector<float> harmonics ((size_t)numChannels);
+
+    for (int s = 0; s < mNumSpeakers; ++s)
+    {
+        evaluateSphericalHarmonics (getDirection (speakerPositions[(size_t)s]), mOrder, harmonics.data());
+
+        for (int k = 0; k < numChannels; ++k)
+            y[(size_t)(k * mNumSpeakers + s)] = harmonics[(size_t)k];
+    }
+
+    // D = Y^T (Y Y^T + lambda I)^-1. The regularisation keeps the decoder sane when
+    // there are fewer speakers than channels, or they only cover part of the sphere.
+    std::vector<double> yyt ((size_t)(numChannels * numChannels), 0.0);
+
+    for (int a = 0; a < numChannels; ++a)
+        for (int b = 0; b < numChannels; ++b)
+            for (int s = 0; s < mNumSpeakers; ++s)
+                yyt[(size_t)(a * numChannels + b)] += y[(size_t)(a * mNumSpeakers + s)] * y[(size_t)(b * mNumSpeakers + s)];
+
+    double trace = 0.0;
+
+    for (int a = 0; a < numChannels; ++a)
+        trace += yyt[(size_t)(a * numChannels + a)];
+
+    const double lambda = 1.0e-2 * trace / numChannels;
+
+    for (int a = 0; a < numChannels; ++a)
+        yyt[(size_t)(a * numChannels + a)] += lambda;
+
+    if (! invertMatrix (yyt, numChannels))
+    {
+        jassertfalse;
+        return;
+    }
+
+    const auto weights = getMaxREWeights (mOrder);
+
+    for (int s = 0; s < mNumSpeakers; ++s)
+    {
+        for (int k = 0; k < numChannels; ++k)
+        {
+            double gain = 0.0;
+
+            for (int a = 0; a < numChannels; ++a)
+                gain += y[(size_t)(a * mNumSpeakers + s)] * yyt[(size_t)(a * numChannels + k)];
+
+            const int l = (int)std::sqrt ((double)k);
+            mDecoderMatrix[(size_t)(s * numChannels + k)] = (float)(gain * weights[(size_t)l]);
+        }
+    }
+
+    // Scale so a source in a speaker's direction has the same total energy as with DBAP
+    double energy = 0.0;
+
+    for (int s = 0; s < mNumSpeakers; ++s)
+    {
+        for (int out = 0; out < mNumSpeakers; ++out)
+        {
+            double gain = 0.0;
+
+            for (int k = 0; k < numChannels; ++k)
+                gain += mDecoderMatrix[(size_t)(out * numChannels + k)] * y[(size_t)(k * mNumSpeakers + s)];
+
+            energy += gain * gain;
+        }
+    }
+
+    if (energy > 0.0)
+    {
+        const float scale = (float)std::sqrt (mNumSpeakers / energy);
+
+        for (auto& gain : mDecoderMatrix)
+            gain *= scale;
+    }
+}
+
+glm::vec3 AmbisonicPanner::getDirection (const glm::vec3& position) const noexcept
+{
+    const glm::vec3 offset = position - mCentre;
+    const float length = glm::length (offset);
+
+    return length > 1.0e-6f ? offset / length : glm::vec3 (0.0f);
+}
+
+void AmbisonicPanner::getEncodingGains (const glm::vec3& position, float* gains) const noexcept
+{
+    const glm::vec3 direction = getDirection (position);
+
+    // A source right in the middle has no direction, so it only goes in the omni channel
+    if (direction == glm::vec3 (0.0f))
+    {
+        FloatVectorOperations::clear (gains, getNumChannels());
+        gains[0] = 1.0f;
+        return;
+    }
+
+    evaluateSphericalHarmonics (direction, mOrder, gains);
+}
+
+void AmbisonicPanner::decode (int numSamples, AudioBuffer<float>& output, int startSample) const noexcept
+{
+    jassert (numSamples <= mBus.getNumSamples());
+    addDecoded (mBus, numSamples, output, startSample);
+}
+
+void AmbisonicPanner::addDecoded (const AudioBuffer<float>& bus, int numSamples, AudioBuffer<float>& output, int startSample) const noexcept
+{
+    const int numChannels = getNumChannels();
+    const int numSpeakers = jmin (mNumSpeakers, output.getNumChannels());
+
+    for (int s = 0; s < numSpeakers; ++s)
+    {
+        float* out = output.getWritePointer (s, startSample);
+        const float* row = mDecoderMatrix.data() + (size_t)(s * numChannels);
+
+        for (int k = 0; k < numChannels; ++k)
+            if (row[k] != 0.0f)
+                FloatVectorOperations::addWithMultiply (out, bus.getReadPointer (k), row[k], numSamples);
+    }
+}
+
+void AmbisonicPanner::decode (int numSamples, AudioBuffer<double>& output, int startSample) const noexcept
+{
+    jassert (numSamples <= mBus.getNumSamples());
+
+    const int numChannels = getNumChannels();
+    const int numSpeakers = jmin (mNumSpeakers, output.getNumChannels());
+
+    for (int s = 0; s < numSpeakers; ++s)
+    {
+        double* out = output.getWritePointer (s, startSample);
+        const float* row = mDecoderMatrix.data() + (size_t)(s * numChannels);
+
+        for (int k = 0; k < numChannels; ++k)
+        {
+            const float* in = mBus.getReadPointer (k);
+
+            for (int i = 0; i < numSamples; ++i)
+                out[i] += (double)(row[k] * in[i]);
+        }
+    }
+}
+
+//==============================================================================
+void AmbisonicPanner::evaluateSphericalHarmonics (const glm::vec3& direction, int order, float* result) noexcept
+{
+    jassert (order >= 0 && order <= maxOrder);
+
+    const double cosTheta = jlimit (-1.0, 1.0, (double)direction.z);
+    const double sinTheta = std::sqrt (jmax (0.0, 1.0 - cosTheta * cosTheta));
+    const double phi = std::atan2 ((double)direction.y, (double)direction.x);
+
+    // Associated Legendre functions P_l^m(cos theta), without the Condon-Shortley phase
+    double legendre[maxOrder + 1][maxOrder + 1] = {};
+    legendre[0][0] = 1.0;
+
+    for (int m = 1; m <= order; ++m)
+        legendre[m][m] = (2 * m - 1) * sinTheta * legendre[m - 1][m - 1];
+
+    for (int m = 0; m < order; ++m)
+        legendre[m + 1][m] = (2 * m + 1) * cosTheta * legendre[m][m];
+
+    for (int m = 0; m <= order; ++m)
+        for (int l = m + 2; l <= order; ++l)
+            legendre[l][m] = ((2 * l - 1) * cosTheta * legendre[l - 1][m] - (l + m - 1) * legendre[l - 2][m]) / (l - m);
+
+    for (int l = 0; l <= order; ++l)
+    {
+        for (int m = -l; m <= l; ++m)
+        {
+            const int absM = std::abs (m);
+
+            // (l - |m|)! / (l + |m|)!
+            double factorialRatio = 1.0;
+
+            for (int i = l - absM + 1; i <= l + absM; ++i)
+                factorialRatio /= i;
+
+            const double norm = std::sqrt ((2 * l + 1) * (absM == 0 ? 1.0 : 2.0) * factorialRatio);
+            const double azimuthal = m > 0 ? std::cos (m * phi)
+                                   : m < 0 ? std::sin (absM * phi)
+                                           : 1.0;
+
+            result[l * l + l + m] = (float)(norm * legendre[l][absM] * azimuthal);
+        }
+    }
+}
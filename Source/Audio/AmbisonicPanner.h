@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    AmbisonicPanner.h
+    Created: 17 Oct 2026 9:41:52pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "vec3.hpp"
+
+//==============================================================================
+/**
+    Pans voices through a higher order Ambisonic bus instead of with DBAP.
+
+    Each voice is encoded into the (order + 1)^2 channels of the bus with a set of
+    spherical harmonic gains, mixed with the same ramped multiply-adds as a DBAP
+    voice, and the whole bus is then decoded to the speakers once per block. The
+    cost of a voice therefore depends on the order rather than the number of
+    speakers, which wins once there are a lot of both.
+
+    The decoder is a regularised mode-matching (pseudo-inverse) decoder with max-rE
+    weighting, built for directions seen from the centre of the speakers. Only the
+    direction of a source is encoded, not its distance.
+
+    @see SpatialSynth
+*/
+class AmbisonicPanner
+{
+public:
+    //==============================================================================
+    /** Builds the decoder for the speakers and allocates a bus that can hold
+        maxBlockSize samples.  (Not the audio thread)
+    */
+    AmbisonicPanner (const std::vector<glm::vec3>& speakerPositions, int order, int maxBlockSize);
+
+    int getOrder() const noexcept                       { return mOrder; }
+    int getNumChannels() const noexcept                 { return getNumChannels (mOrder); }
+    int getNumSpeakers() const noexcept                 { return mNumSpeakers; }
+
+    static int getNumChannels (int order) noexcept      { return (order + 1) * (order + 1); }
+
+    /** Writes the gain of each Ambisonic channel for a source at the given position. */
+    void getEncodingGains (const glm::vec3& position, float* gains) const noexcept;
+
+    /** The bus that voices are rendered into before decoding. */
+    AudioBuffer<float>& getBus() noexcept               { return mBus; }
+
+    /** Adds the first numSamples of the bus, decoded, to the speaker channels. */
+    void decode (int numSamples, AudioBuffer<float>& output, int startSample) const noexcept;
+    void decode (int numSamples, AudioBuffer<double>& output, int startSample) const noexcept;
+
+    /** Evaluates the real, N3D normalised spherical harmonics up to the given order for
+        a unit direction, in ACN order.
+    */
+    static void evaluateSphericalHarmonics (const glm::vec3& direction, int order, float* result) noexcept;
+
+    static constexpr int minOrder = 1;
+    static constexpr int maxOrder = 5;
+
+private:
+    //==============================================================================
+    glm::vec3 getDirection (const glm::vec3& position) const noexcept;
+    void addDecoded (const AudioBuffer<float>& bus, int numSamples, AudioBuffer<float>& output, int startSample) const noexcept;
+
+    int                 mOrder = 1;
+    int                 mNumSpeakers = 0;
+    glm::vec3           mCentre;
+
+    // numSpeakers rows of getNumChannels() gains
+    std::vector<float>  mDecoderMatrix;
+    AudioBuffer<float>  mBus;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AmbisonicPanner)
+};
@@ -15,29 +15,29 @@
 #include "SoundEventData.h"
 #include "AudioFileSource.h"
 #include "AudioMonitorSource.h"
+#include "SoundBankLoader.h"
+#include "RealtimeSnapshot.h"
 
 /** This class controls and contains all the audio functionality of the app.
 */
-class AudioController   : public AudioSource
+class AudioController   : public AudioSource,
+                          private Timer
 {
 public:
     AudioController(AudioDeviceManager& deviceManager)
-        : mDeviceManager(deviceManager)
+        : mDeviceManager(deviceManager),
+          mSoundBankLoader(mReadAheadThread)
     {
-        mFormatManager.registerBasicFormats();
-        
-        mSoundEventData.onProcessEvent = [&](const SoundEvent& e) {
-            if (e.isStartNote())
-                mSynth.noteOn(e.noteID, e.soundID, 1.0f, e.position);
-            else
-                mSynth.handlePositionChange(e.noteID, e.position);
-        };
-        
         mMonitor.reset(new AudioMonitorSource());
+        mReadAheadThread.startThread();
+        
+        // Old sound banks are deleted here rather than on the audio thread
+        startTimer(500);
     }
     
     ~AudioController()
     {
+        stopTimer();
         shutdownAudio();
         jassert(mAudioSourcePlayer.getCurrentSource() == nullptr);
     }
@@ -67,20 +67,31 @@ public:
         Logger::getCurrentLogger()->writeToLog (message);
         
         mSynth.setSampleRate(sampleRate);
+        mSoundEventData.prepareToPlay(sampleRate, samplesPerBlockExpected);
+        
+        // The source player's buffer has a channel for every active input or output
+        int numChannels = 2;
         
-        for (auto& src : mAtmosphereSources)
-            src->prepareToPlay(samplesPerBlockExpected, sampleRate);
+        if (auto* device = mDeviceManager.getCurrentAudioDevice())
+            numChannels = jmax(device->getActiveInputChannels().countNumberOfSetBits(),
+                               device->getActiveOutputChannels().countNumberOfSetBits());
+        
+        mSynth.prepareRenderBuffers(numChannels, samplesPerBlockExpected);
     }
 
     void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override
     {
-        ScopedLock fileDataLock(mFileDataMutex);
+        // Swap in any new sounds before the events that might use them
+        mSoundBank.update();
+        mSynth.handleMessageThreadChanges();
         
-        mSoundEventData.processEventData();
-        mSynth.renderNextBlock(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+        // The synth splits the block at each event so they play at the sample they're due
+        const auto& events = mSoundEventData.getEventsForNextBlock(bufferToFill.numSamples);
+        mSynth.renderNextBlock(*bufferToFill.buffer, events, bufferToFill.startSample, bufferToFill.numSamples);
         
-        for (auto& atmosphere : mAtmosphereSources)
-            atmosphere->getNextAudioBlock(bufferToFill);
+        if (auto* bank = mSoundBank.get())
+            for (auto& atmosphere : bank->mAtmospheres)
+                atmosphere->getNextAudioBlock(bufferToFill);
             
         mMonitor->getNextAudioBlock(bufferToFill);
     }
@@ -93,80 +104,70 @@ public:
     
     // ===== Events ===========================
     
+    // Decodes the folders in the background, the current sounds keep playing until it's done
     void loadAudioFiles(AudioDataState& data)
     {
-        ScopedLock dataLock(mFileDataMutex);
-        
-        // Load soundatmosphere files
-        auto atmosphereFiles = data.mCurrentSoundAtmosphereFolder.findChildFiles(File::TypesOfFileToFind::findFiles, false);
-        data.mSoundAtmosphereData.clear();
-        mAtmosphereSources.clear();
-        
-        for (auto& atmosphereFile : atmosphereFiles)
+        mSoundBankLoader.onBankLoaded = [this, &data](std::unique_ptr<SoundBank> bank)
         {
-            std::unique_ptr<AudioFormatReader> atmosphereReader(mFormatManager.createReaderFor(atmosphereFile));
-            
-            if (atmosphereReader != nullptr)
-            {
-                const auto name = atmosphereFile.getFileNameWithoutExtension();
-                auto* newSound = new AudioFileSource(name, *atmosphereReader);
-                const double fileLength = (double)atmosphereReader->lengthInSamples / (double)atmosphereReader->sampleRate;
-                data.addSoundAtmosphereData(name, *newSound->getAudioData(), fileLength);
-                mAtmosphereSources.emplace_back(newSound);
-            }
-        }
-        
-        // Load spatial clip files
-        data.mSoundClipData.clear();
-        
-        mSynth.clearSounds();
-        mSynth.clearVoices();
-        
-        File folder = data.mCurrentSoundClipFolder;
-        auto clipFiles = folder.findChildFiles(File::TypesOfFileToFind::findFiles, false);
-        
-        int noteID = 0;
+            publishSoundBank(std::move(bank), data);
+        };
         
-        for (auto& wavFile : clipFiles)
-        {
-            std::unique_ptr<AudioFormatReader> reader(mFormatManager.createReaderFor(wavFile));
-            
-            if (reader != nullptr)
-            {
-                const auto name = wavFile.getFileNameWithoutExtension();
-                auto* newSound = new SpatialSamplerSound(wavFile.getFileNameWithoutExtension(), *reader, noteID, 0.01, 0.5, 20.0);
-                const double fileLength = (double)reader->lengthInSamples / (double)reader->sampleRate;
-
-                data.addSoundClipData(newSound->getName(), *newSound->getAudioData(), fileLength);
-                
-                mSynth.addSound(newSound);
-                mSynth.addVoice(new SpatialSamplerVoice());
-                noteID++;
-            }
-        }
-        
-        if (clipFiles.size() == 0)
-        {
-            Logger::getCurrentLogger()->writeToLog("Failed to find any .wavs");
-        }
-
-        data.sendSynchronousChangeMessage();
+        mSoundBankLoader.loadFolders(data.mCurrentSoundClipFolder, data.mCurrentSoundAtmosphereFolder);
+    }
+    
+    // Atmospheres that would take more than this much memory are streamed from disk
+    void setAtmosphereStreamingThreshold(int64 numBytes)
+    {
+        mSoundBankLoader.setStreamingThreshold(numBytes);
+    }
+    
+    // Clips can be mapped from a cache file after the first load instead of decoded
+    void setUseClipCache(bool shouldUseCache)
+    {
+        mSoundBankLoader.setUseClipCache(shouldUseCache);
+    }
+    
+    // The number of clips that can play at once, independent of how many clips are loaded
+    void setNumVoices(int numVoices)
+    {
+        if (numVoices != mSynth.getNumVoices())
+            mSynth.setVoicePool<SpatialSamplerVoice>(numVoices);
     }
     
-    // Manages lockfree message processing with a fifo
-    void addSoundEvent(const SoundEvent& event)
+    // Each thread that sends events to the audio engine needs its own producer, which it
+    // must delete before this object. Only SoundEventData::maxNumProducers (8) can exist
+    // at once, after that this returns nullptr. Events with a time are played at that
+    // time, others are played one block after they are added
+    std::unique_ptr<SoundEventData::Producer> createEventProducer()
     {
-        mSoundEventData.addSoundEvent(event);
+        return mSoundEventData.createProducer();
+    }
+    
+    // Position updates for the same note in one block are merged into one
+    uint32 getNumMergedPositionUpdates() const
+    {
+        return mSoundEventData.getNumMergedUpdates();
+    }
+    
+    // How many events can be waiting to be played. This can only be changed
+    // before initialise(), while nothing is adding or playing events
+    void setEventQueueCapacity(int capacity)
+    {
+        jassert(mAudioSourcePlayer.getCurrentSource() == nullptr);
+        mSoundEventData.setCapacity(capacity);
+    }
+    
+    SoundEventData::Statistics getEventQueueStatistics() const
+    {
+        return mSoundEventData.getStatistics();
     }
     
     void setSoundAtmosphereAmplitudes(const std::vector<float>& amps)
     {
-        ScopedLock dataLock(mFileDataMutex);
-
-        jassert(amps.size() == mAtmosphereSources.size());
+        mAtmosphereAmplitudes = amps;
         
-        for (int i = 0; i < amps.size(); ++i)
-            mAtmosphereSources[i]->setAmplitude(amps[i]);
+        if (mMessageThreadSoundBank != nullptr)
+            applyAtmosphereAmplitudes(*mMessageThreadSoundBank);
     }
     
     std::vector<float> getAudioLevels()
@@ -176,23 +177,89 @@ public:
         
     AudioDeviceManager& getDeviceManager() { return mDeviceManager; }
 
-    // All public access to this method on the message thread
-    // will cause locking, so only use on initialisation etc.
+    // Changes made on the message thread are queued and picked
+    // up by the audio thread at the start of its next block
     SpatialSynth       mSynth;
 
 private:
 
-    std::vector<std::unique_ptr<AudioFileSource>>    mAtmosphereSources;
+    void publishSoundBank(std::unique_ptr<SoundBank> bank, AudioDataState& data)
+    {
+        data.mSoundClipData = std::move(bank->mClipData);
+        data.mSoundAtmosphereData = std::move(bank->mAtmosphereData);
+        
+        // Notes on the old sounds play out, the synth releases them once they finish
+        mSynth.setSounds(bank->mClipSounds);
+        bank->mClipSounds.clear();
+        
+        applyAtmosphereAmplitudes(*bank);
+        mMessageThreadSoundBank = bank.get();
+        mSoundBank.publish(std::move(bank));
+        
+        data.sendSynchronousChangeMessage();
+    }
+    
+    void applyAtmosphereAmplitudes(SoundBank& bank)
+    {
+        // The levels may not have been reset for a newly loaded bank yet
+        for (int i = 0; i < bank.mAtmospheres.size(); ++i)
+            bank.mAtmospheres[i]->setAmplitude(i < mAtmosphereAmplitudes.size() ? mAtmosphereAmplitudes[i] : 0.0f);
+    }
+    
+    void timerCallback() override
+    {
+        mSoundBank.releaseRetiredObjects();
+        logEventQueueOverflows();
+        logStreamingUnderruns();
+    }
+    
+    void logStreamingUnderruns()
+    {
+        if (mMessageThreadSoundBank == nullptr)
+            return;
+        
+        for (auto& atmosphere : mMessageThreadSoundBank->mAtmospheres)
+            if (const uint32 numUnderruns = atmosphere->takeNumUnderruns())
+                Logger::getCurrentLogger()->writeToLog("Disk couldn't keep up with " + atmosphere->getName() + ": "
+                                                       + String((int)numUnderruns) + " blocks were cut short");
+    }
+    
+    void logEventQueueOverflows()
+    {
+        const auto stats = mSoundEventData.getStatistics();
+        const uint32 numDroppedUpdates = stats.numDroppedUpdates - mLoggedEventQueueStats.numDroppedUpdates;
+        const uint32 numDroppedStarts = stats.numDroppedStarts - mLoggedEventQueueStats.numDroppedStarts;
+        
+        if (numDroppedUpdates == 0 && numDroppedStarts == 0)
+            return;
+        
+        String message;
+        message << "Sound event queue overflowed (peak " << stats.highWaterMark << " of " << stats.capacity << " events): "
+                << (int)numDroppedUpdates << " position updates dropped, "
+                << (int)numDroppedStarts << " start events dropped";
+        Logger::getCurrentLogger()->writeToLog(message);
+        
+        mLoggedEventQueueStats = stats;
+    }
+
     std::unique_ptr<AudioMonitorSource> mMonitor;
 
     SoundEventData     mSoundEventData;
+    SoundEventData::Statistics mLoggedEventQueueStats;
+    
+    // Keeps streamed atmospheres read ahead, it must outlive the sound banks
+    TimeSliceThread    mReadAheadThread { "Atmosphere Read Ahead" };
     
-    CriticalSection    mFileDataMutex;
+    // The atmospheres playing on the audio thread, and a pointer to the most
+    // recently published bank for the message thread
+    RealtimeSnapshot<SoundBank> mSoundBank;
+    SoundBank*         mMessageThreadSoundBank = nullptr;
+    std::vector<float> mAtmosphereAmplitudes;
 
     AudioDeviceManager& mDeviceManager;
     AudioSourcePlayer   mAudioSourcePlayer;
     
     // File loading
-    AudioFormatManager  mFormatManager;
+    SoundBankLoader     mSoundBankLoader;
     
 };
@@ -14,10 +14,17 @@
 
 /** This Audio source plays an audio file on loop and sequentially
     allocates the channels in the file to the desired number of output channels.
+
+    Files can either be read into memory up front, or streamed from disk. When
+    streaming, a background thread keeps a ring buffer filled ahead of playback,
+    carrying on from the start of the file when it reaches the end so that the
+    loop stays seamless.
 */
-class AudioFileSource : AudioSource
+class AudioFileSource : AudioSource,
+                        private TimeSliceClient
 {
 public:
+    /** Reads the whole file into memory. */
     AudioFileSource(const String& name,
                     AudioFormatReader& source)
       : mName(name),
@@ -32,6 +39,32 @@ public:
         }
     }
     
+    /** Streams the file from disk using the given thread to read ahead. */
+    AudioFileSource(const String& name,
+                    std::unique_ptr<AudioFormatReader> source,
+                    TimeSliceThread& readAheadThread)
+      : mName(name),
+        mSourceSampleRate(source->sampleRate),
+        mReader(std::move(source)),
+        mReadAheadThread(&readAheadThread),
+        mRingFifo(jmax(minRingSize, (int)(mSourceSampleRate * ringLengthSeconds)))
+    {
+        mRing.setSize((int)mReader->numChannels, mRingFifo.getTotalSize());
+        
+        if (mSourceSampleRate > 0 && mReader->lengthInSamples > 0)
+        {
+            // Fill the ring before playback starts, then keep it topped up
+            while (readAhead() > 0) {}
+            
+            mReadAheadThread->addTimeSliceClient(this);
+        }
+    }
+    
+    ~AudioFileSource()
+    {
+        if (mReadAheadThread != nullptr)
+            mReadAheadThread->removeTimeSliceClient(this);
+    }
 
     void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
     {
@@ -44,6 +77,34 @@ public:
     }
 
     void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override
+    {
+        // Basic amplitude smoothing
+        mAmplitude += (mTargetAmplitude.load() - mAmplitude) * 0.1f;
+        
+        if (mReader != nullptr)
+            renderStreamedBlock(bufferToFill);
+        else if (mData != nullptr)
+            renderPreloadedBlock(bufferToFill);
+    }
+    
+    void setAmplitude(float newAmp)
+    {
+        mTargetAmplitude = newAmp;
+    }
+    
+    bool isStreaming() const { return mReader != nullptr; }
+    
+    /** Returns the file's audio, or nullptr if it is being streamed. */
+    const AudioBuffer<float>* getAudioData() const { return mData.get(); }
+    const String& getName() const { return mName; }
+    
+    /** Returns the number of blocks that were partly silent because the disk couldn't
+        keep up with a streamed file since the last call, and resets the count.
+    */
+    uint32 takeNumUnderruns() { return mNumUnderruns.exchange(0); }
+    
+private:
+    void renderPreloadedBlock(const AudioSourceChannelInfo& bufferToFill)
     {
         // Get sample data
 
@@ -53,9 +114,6 @@ public:
             
         const int fileChannels = mData->getNumChannels();
         const int outChannels = outputBuffer.getNumChannels();
-        
-        // Basic amplitude smoothing
-        mAmplitude += (mTargetAmplitude - mAmplitude) * 0.1f;
     
         int i = 0;
         
@@ -86,19 +144,88 @@ public:
         }
     }
     
-    void setAmplitude(float newAmp)
+    void renderStreamedBlock(const AudioSourceChannelInfo& bufferToFill)
     {
-        mTargetAmplitude = newAmp;
+        AudioBuffer<float>& outputBuffer = *bufferToFill.buffer;
+        const int fileChannels = mRing.getNumChannels();
+        const int outChannels = outputBuffer.getNumChannels();
+        
+        int start1, size1, start2, size2;
+        mRingFifo.prepareToRead(bufferToFill.numSamples, start1, size1, start2, size2);
+        
+        // If the disk falls behind the rest of the block is left silent
+        if (size1 + size2 < bufferToFill.numSamples)
+            ++mNumUnderruns;
+        
+        for (int ch = 0; ch < outChannels; ++ch)
+        {
+            const int chIndex = ch % fileChannels;
+            
+            if (size1 > 0)
+                outputBuffer.addFrom(ch, bufferToFill.startSample, mRing, chIndex, start1, size1, mAmplitude);
+            
+            if (size2 > 0)
+                outputBuffer.addFrom(ch, bufferToFill.startSample + size1, mRing, chIndex, start2, size2, mAmplitude);
+        }
+        
+        mRingFifo.finishedRead(size1 + size2);
     }
     
-    const AudioBuffer<float>* getAudioData() { return mData.get(); }
+    // Reads the next chunk of the file into the ring, returning the number of samples read
+    int readAhead()
+    {
+        int start1, size1, start2, size2;
+        mRingFifo.prepareToWrite(readChunkSize, start1, size1, start2, size2);
+        
+        readLooped(start1, size1);
+        readLooped(start2, size2);
+        
+        mRingFifo.finishedWrite(size1 + size2);
+        return size1 + size2;
+    }
+    
+    void readLooped(int ringStart, int numSamples)
+    {
+        const int64 fileLength = mReader->lengthInSamples;
+        
+        while (numSamples > 0)
+        {
+            const int numToRead = (int)jmin((int64)numSamples, fileLength - mReadPosition);
+            mReader->read(&mRing, ringStart, numToRead, mReadPosition, true, true);
+            
+            ringStart += numToRead;
+            numSamples -= numToRead;
+            mReadPosition += numToRead;
+            
+            // Looping
+            if (mReadPosition >= fileLength)
+                mReadPosition = 0;
+        }
+    }
+    
+    int useTimeSlice() override
+    {
+        // Come back straight away if there's more to read, otherwise wait a little
+        return readAhead() > 0 ? 0 : 20;
+    }
     
-private:
     float   mAmplitude = 0.0f;
-    float   mTargetAmplitude = 0.0f;
+    std::atomic<float> mTargetAmplitude { 0.0f };
     String  mName;
     std::unique_ptr<AudioBuffer<float>> mData;
     double  mSourceSampleRate;
     double  mSourceSamplePosition = 0;
     
+    // Streaming
+    static constexpr double ringLengthSeconds = 2.0;
+    static constexpr int    minRingSize = 32768;
+    static constexpr int    readChunkSize = 8192;
+    
+    std::unique_ptr<AudioFormatReader> mReader;
+    TimeSliceThread*    mReadAheadThread = nullptr;
+    std::atomic<uint32> mNumUnderruns { 0 };
+    AbstractFifo        mRingFifo { 1 };
+    AudioBuffer<float>  mRing;
+    int64               mReadPosition = 0;
+    
 };
@@ -0,0 +1,197 @@
+/*
+  ==============================================================================
+
+    ClipSampleCache.cpp
+    Created: 17 Oct 2026 6:03:15pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "ClipSampleCache.h"
+
+
+//==============================================================================
+File ClipSampleCache::getCacheFile (const File& clipFolder)
+{
+    auto cacheFolder = File::getSpecialLocation (File::userApplicationDataDirectory)
+                      #if JUCE_MAC
+                        .getChildFile ("Caches")
+                      #endif
+                        .getChildFile ("SoundscaperOSC")
+                        .getChildFile ("ClipCache");
+
+    return cacheFolder.getChildFile (String::toHexString (clipFolder.getFullPathName().hashCode64()) + ".cache");
+}
+
+ClipSampleCache::Ptr ClipSampleCache::open (const File& clipFolder)
+{
+    const auto cacheFile = getCacheFile (clipFolder);
+    FileInputStream in (cacheFile);
+
+    if (in.failedToOpen()
+         || (uint32)in.readInt() != fileFormatMagic
+         || (uint32)in.readInt() != fileFormatVersion)
+        return nullptr;
+
+    const int numEntries = in.readInt();
+
+    if (numEntries < 0)
+        return nullptr;
+
+    Ptr cache (new ClipSampleCache());
+
+    for (int i = 0; i < numEntries; ++i)
+    {
+        if (in.isExhausted())
+            return nullptr;
+
+        Entry entry;
+        entry.filePath          = in.readString();
+        entry.fileSize          = in.readInt64();
+        entry.modificationTime  = in.readInt64();
+        entry.sampleRate        = in.readDouble();
+        entry.fileLength        = in.readDouble();
+        entry.numSamples        = in.readInt();
+        entry.dataOffset        = in.readInt64();
+
+        const int waveformSize = in.readInt();
+
+        if (waveformSize < 0 || waveformSize > maxWaveformSize)
+            return nullptr;
+
+        entry.waveform.resize ((size_t)waveformSize);
+        in.read (entry.waveform.data(), waveformSize * (int)sizeof (float));
+
+        cache->mEntryIndices.set (entry.filePath, (int)cache->mEntries.size());
+        cache->mEntries.push_back (std::move (entry));
+    }
+
+    cache->mMappedFile.reset (new MemoryMappedFile (cacheFile, MemoryMappedFile::readOnly));
+
+    if (cache->mMappedFile->getData() == nullptr)
+        return nullptr;
+
+    const auto mappedSize = (int64)cache->mMappedFile->getSize();
+
+    // A damaged table mustn't point outside the mapped data, in either direction
+    for (auto& entry : cache->mEntries)
+    {
+        const auto numBytes = (int64)entry.numSamples * (int64)sizeof (float);
+
+        if (entry.numSamples < 0 || entry.dataOffset < 0 || entry.dataOffset > mappedSize - numBytes)
+            return nullptr;
+    }
+
+    return cache;
+}
+
+bool ClipSampleCache::write (const File& clipFolder, const Array<File>& clipFiles, const std::vector<SourceClip>& clips)
+{
+    jassert ((int)clips.size() == clipFiles.size());
+
+    const auto cacheFile = getCacheFile (clipFolder);
+
+    if (! cacheFile.getParentDirectory().createDirectory())
+        return false;
+
+    // Work out the size of the table so the sample data offsets are known up front
+    MemoryOutputStream table;
+    int64 dataOffset = 0;
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        table.reset();
+        table.writeInt ((int)fileFormatMagic);
+        table.writeInt ((int)fileFormatVersion);
+        table.writeInt (clipFiles.size());
+
+        int64 offset = dataOffset;
+
+        for (size_t i = 0; i < clips.size(); ++i)
+        {
+            const auto& clip = clips[i];
+            const auto& clipFile = clipFiles.getReference ((int)i);
+            const int numSamples = clip.monoData != nullptr ? clip.monoData->getNumSamples() : 0;
+            const int waveformSize = clip.waveform != nullptr ? (int)clip.waveform->size() : 0;
+
+            jassert (waveformSize <= maxWaveformSize);
+
+            table.writeString (clipFile.getFullPathName());
+            table.writeInt64 (clipFile.getSize());
+            table.writeInt64 (clipFile.getLastModificationTime().toMilliseconds());
+            table.writeDouble (clip.sampleRate);
+            table.writeDouble (clip.fileLength);
+            table.writeInt (numSamples);
+            table.writeInt64 (offset);
+            table.writeInt (waveformSize);
+
+            if (waveformSize > 0)
+                table.write (clip.waveform->data(), (size_t)waveformSize * sizeof (float));
+
+            offset += roundUpToAlignment ((int64)numSamples * (int64)sizeof (float));
+        }
+
+        dataOffset = roundUpToAlignment ((int64)table.getDataSize());
+    }
+
+    // Write to a temporary file so a half written cache is never opened
+    TemporaryFile tempFile (cacheFile);
+
+    {
+        FileOutputStream out (tempFile.getFile());
+
+        if (out.failedToOpen())
+            return false;
+
+        out.write (table.getData(), table.getDataSize());
+
+        for (auto& clip : clips)
+        {
+            out.writeRepeatedByte (0, (size_t)(roundUpToAlignment (out.getPosition()) - out.getPosition()));
+
+            if (clip.monoData != nullptr)
+                out.write (clip.monoData->getReadPointer (0), (size_t)clip.monoData->getNumSamples() * sizeof (float));
+        }
+
+        out.flush();
+
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary();
+}
+
+//==============================================================================
+int ClipSampleCache::findEntry (const File& clipFile) const
+{
+    const auto path = clipFile.getFullPathName();
+
+    if (! mEntryIndices.contains (path))
+        return -1;
+
+    const int index = mEntryIndices[path];
+    const auto& entry = mEntries[(size_t)index];
+
+    if (entry.fileSize != clipFile.getSize()
+         || entry.modificationTime != clipFile.getLastModificationTime().toMilliseconds())
+        return -1;
+
+    return index;
+}
+
+const float* ClipSampleCache::getSamples (int index) const noexcept
+{
+    const auto& entry = mEntries[(size_t)index];
+
+    if (entry.numSamples == 0)
+        return nullptr;
+
+    return reinterpret_cast<const float*> (static_cast<const char*> (mMappedFile->getData()) + entry.dataOffset);
+}
+
+int64 ClipSampleCache::roundUpToAlignment (int64 numBytes) noexcept
+{
+    return (numBytes + dataAlignment - 1) / dataAlignment * dataAlignment;
+}
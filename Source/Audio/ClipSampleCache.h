@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    ClipSampleCache.h
+    Created: 17 Oct 2026 6:03:15pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** A file holding the decoded mono samples and waveform overview of every clip in
+    a folder.
+
+    The file is memory mapped rather than read, so a large library costs page cache
+    instead of private memory, loads without decoding anything after the first run,
+    and is shared between any processes playing the same folder.
+
+    Each clip is keyed by its path, size and modification time, so when a folder
+    changes only the clips that are new or different need decoding again.
+*/
+class ClipSampleCache    : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<ClipSampleCache>;
+
+    /** One clip in the cache. Clips that couldn't be decoded have no samples. */
+    struct Entry
+    {
+        String              filePath;
+        int64               fileSize = 0;
+        int64               modificationTime = 0;
+        double              sampleRate = 0.0;
+        double              fileLength = 0.0;
+        int                 numSamples = 0;
+        int64               dataOffset = 0;
+        std::vector<float>  waveform;
+    };
+
+    /** The decoded data for one clip, used to write a new cache. */
+    struct SourceClip
+    {
+        double                      sampleRate = 0.0;
+        double                      fileLength = 0.0;
+        const AudioBuffer<float>*   monoData = nullptr;
+        const std::vector<float>*   waveform = nullptr;
+    };
+
+    /** Maps the cache for the given folder, or returns nullptr if there isn't one
+        or it was written by a different version.
+    */
+    static Ptr open (const File& clipFolder);
+
+    /** Writes a cache for the folder with one SourceClip for each of the clip files.
+        Returns false if it couldn't be written.
+    */
+    static bool write (const File& clipFolder, const Array<File>& clipFiles, const std::vector<SourceClip>& clips);
+
+    /** Returns the file the cache for a folder is stored in. */
+    static File getCacheFile (const File& clipFolder);
+
+    //==============================================================================
+    int             getNumEntries() const noexcept              { return (int)mEntries.size(); }
+    const Entry&    getEntry (int index) const noexcept         { return mEntries[(size_t)index]; }
+
+    /** Returns the index of the entry for a clip file, or -1 if it isn't in the
+        cache or has changed since the cache was written.
+    */
+    int             findEntry (const File& clipFile) const;
+
+    /** Returns the mono samples for a clip. These are read only. */
+    const float*    getSamples (int index) const noexcept;
+
+private:
+    ClipSampleCache() = default;
+
+    static int64 roundUpToAlignment (int64 numBytes) noexcept;
+
+    static constexpr uint32 fileFormatMagic = 0x53534343; // "SSCC"
+    static constexpr uint32 fileFormatVersion = 2;
+    static constexpr int    dataAlignment = 64;
+    static constexpr int    maxWaveformSize = 4096;
+
+    std::unique_ptr<MemoryMappedFile>   mMappedFile;
+    std::vector<Entry>                  mEntries;
+    HashMap<String, int>                mEntryIndices;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ClipSampleCache)
+};
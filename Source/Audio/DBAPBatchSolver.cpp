@@ -0,0 +1,104 @@
+/*
+  ==============================================================================
+
+    DBAPBatchSolver.cpp
+    Created: 17 Oct 2026 9:02:14pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "DBAPBatchSolver.h"
+#include "SpatialSynthVoice.h"
+
+
+//==============================================================================
+void DBAPBatchSolver::setSpeakerPositions (const std::vector<glm::vec3>& positions)
+{
+    const size_t numSpeakers = positions.size();
+
+    mSpeakerX.resize (numSpeakers);
+    mSpeakerY.resize (numSpeakers);
+    mSpeakerZ.resize (numSpeakers);
+    mInverseDistances.resize (numSpeakers);
+
+    for (size_t i = 0; i < numSpeakers; ++i)
+    {
+        mSpeakerX[i] = positions[i].x;
+        mSpeakerY[i] = positions[i].y;
+        mSpeakerZ[i] = positions[i].z;
+    }
+
+   #if JUCE_DEBUG
+    mSpeakerPositions = positions;
+    mScalarGains.resize (numSpeakers);
+   #endif
+}
+
+void DBAPBatchSolver::calculateGains (const glm::vec3* sourcePositions, float* const* gains, int numSources) noexcept
+{
+    for (int i = 0; i < numSources; ++i)
+        calculateGains (sourcePositions[i], gains[i]);
+
+   #if JUCE_DEBUG
+    // Spot check one source per batch against the exact gains
+    if (numSources > 0)
+        checkAgainstScalarGains (sourcePositions[0], gains[0]);
+   #endif
+}
+
+void DBAPBatchSolver::calculateGains (const glm::vec3& sourcePosition, float* gains) noexcept
+{
+    const int numSpeakers = getNumSpeakers();
+    const float* sx = mSpeakerX.data();
+    const float* sy = mSpeakerY.data();
+    const float* sz = mSpeakerZ.data();
+    float* invDist = mInverseDistances.data();
+
+    const float px = sourcePosition.x;
+    const float py = sourcePosition.y;
+    const float pz = sourcePosition.z;
+
+    // With an exponent of 1/2 the unnormalised gain is 1 / d^(1/2), so its square
+    // is just 1 / d
+    for (int i = 0; i < numSpeakers; ++i)
+    {
+        const float dx = sx[i] - px;
+        const float dy = sy[i] - py;
+        const float dz = sz[i] - pz;
+        invDist[i] = 1.0f / std::sqrt (dx * dx + dy * dy + dz * dz);
+    }
+
+    // Four partial sums so the reduction doesn't serialise on one register
+    float sums[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    int i = 0;
+
+    for (; i + 4 <= numSpeakers; i += 4)
+    {
+        sums[0] += invDist[i];
+        sums[1] += invDist[i + 1];
+        sums[2] += invDist[i + 2];
+        sums[3] += invDist[i + 3];
+    }
+
+    for (; i < numSpeakers; ++i)
+        sums[0] += invDist[i];
+
+    const float k = 1.0f / std::sqrt ((sums[0] + sums[1]) + (sums[2] + sums[3]));
+
+    // A source sitting on a speaker gives an infinite distance sum and k = 0, the NaN
+    // that speaker's gain becomes is clamped to 1 like in the scalar version
+    for (int j = 0; j < numSpeakers; ++j)
+        gains[j] = jmin (1.0f, k * std::sqrt (invDist[j]));
+}
+
+#if JUCE_DEBUG
+void DBAPBatchSolver::checkAgainstScalarGains (const glm::vec3& sourcePosition, const float* gains)
+{
+    const int numSpeakers = getNumSpeakers();
+    SpatialSynthVoice::calculateDBAPGains (mSpeakerPositions, sourcePosition, mScalarGains.data(), numSpeakers);
+
+    for (int i = 0; i < numSpeakers; ++i)
+        jassert (std::abs (gains[i] - mScalarGains[(size_t)i]) < 0.02f);
+}
+#endif
@@ -0,0 +1,57 @@
+/*
+  ==============================================================================
+
+    DBAPBatchSolver.h
+    Created: 17 Oct 2026 9:02:14pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "vec3.hpp"
+
+//==============================================================================
+/**
+    Calculates the DBAP gains for a batch of source positions at once.
+
+    The speaker positions are kept as separate x, y and z arrays, so every step is
+    a simple loop over the speakers that the compiler can vectorise, and the
+    per-speaker pow of the scalar path is replaced with square roots.
+
+    The distance exponent is taken as exactly 1/2, which is the DBAP rolloff for
+    20 log10(2) = 6.02dB rather than 6dB. The gains differ from the scalar
+    SpatialSynthVoice::calculateDBAPGains() by well under 1%.
+
+    @see SpatialSynthVoice, DBAPGainGrid
+*/
+class DBAPBatchSolver
+{
+public:
+    //==============================================================================
+    /** Sets the speakers and allocates the working memory.  (Not the audio thread) */
+    void setSpeakerPositions (const std::vector<glm::vec3>& positions);
+
+    int getNumSpeakers() const noexcept                 { return (int)mSpeakerX.size(); }
+
+    /** Writes getNumSpeakers() normalised gains to gains[i] for each of the source positions. */
+    void calculateGains (const glm::vec3* sourcePositions, float* const* gains, int numSources) noexcept;
+
+    /** The most sources worth gathering into one call. */
+    static constexpr int maxBatchSize = 64;
+
+private:
+    //==============================================================================
+    void calculateGains (const glm::vec3& sourcePosition, float* gains) noexcept;
+
+   #if JUCE_DEBUG
+    void checkAgainstScalarGains (const glm::vec3& sourcePosition, const float* gains);
+    std::vector<glm::vec3>  mSpeakerPositions;
+    std::vector<float>      mScalarGains;
+   #endif
+
+    std::vector<float>      mSpeakerX, mSpeakerY, mSpeakerZ;
+    std::vector<float>      mInverseDistances;
+};
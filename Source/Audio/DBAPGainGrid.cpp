@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    DBAPGainGrid.cpp
+    Created: 17 Oct 2026 8:24:37pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "DBAPGainGrid.h"
+#include "SpatialSynthVoice.h"
+#include "common.hpp"
+
+
+//==============================================================================
+std::unique_ptr<DBAPGainGrid> DBAPGainGrid::build (const std::vector<glm::vec3>& speakerPositions,
+                                                   int resolution,
+                                                   const std::function<bool()>& shouldCancel)
+{
+    const int numSpeakers = (int)speakerPositions.size();
+
+    if (numSpeakers == 0)
+        return nullptr;
+
+    resolution = jlimit (minResolution, maxResolution, resolution);
+
+    while (resolution > minResolution && (size_t)(resolution * resolution * resolution) * (size_t)numSpeakers > maxNumGains)
+        --resolution;
+
+    std::unique_ptr<DBAPGainGrid> grid (new DBAPGainGrid());
+    grid->mResolution = resolution;
+    grid->mNumSpeakers = numSpeakers;
+
+    // Pad the speakers' bounding box a little, so that a flat layout still has some
+    // height and sources sitting on the outer speakers are inside the grid
+    glm::vec3 min = speakerPositions[0];
+    glm::vec3 max = speakerPositions[0];
+
+    for (const auto& p : speakerPositions)
+    {
+        min = glm::min (min, p);
+        max = glm::max (max, p);
+    }
+
+    const glm::vec3 size = max - min;
+    const float padding = jmax (0.05f * jmax (size.x, size.y, size.z), 0.01f);
+    min -= glm::vec3 (padding);
+    max += glm::vec3 (padding);
+
+    grid->mMin = min;
+    grid->mCellSize = (max - min) / (float)(resolution - 1);
+    grid->mInvCellSize = 1.0f / grid->mCellSize;
+    grid->mGains.resize ((size_t)(resolution * resolution * resolution) * (size_t)numSpeakers);
+
+    for (int z = 0; z < resolution; ++z)
+    {
+        if (shouldCancel != nullptr && shouldCancel())
+            return nullptr;
+
+        for (int y = 0; y < resolution; ++y)
+        {
+            for (int x = 0; x < resolution; ++x)
+            {
+                const glm::vec3 point = min + grid->mCellSize * glm::vec3 ((float)x, (float)y, (float)z);
+                auto* gains = grid->mGains.data() + grid->getPointIndex (x, y, z);
+                SpatialSynthVoice::calculateDBAPGains (speakerPositions, point, gains, numSpeakers);
+            }
+        }
+    }
+
+    return grid;
+}
+
+bool DBAPGainGrid::getGains (const glm::vec3& position, float* gains, int numSpeakers) const noexcept
+{
+    const glm::vec3 cell = (position - mMin) * mInvCellSize;
+    const float lastCell = (float)(mResolution - 1);
+
+    if (numSpeakers != mNumSpeakers
+         || ! (cell.x >= 0.0f && cell.y >= 0.0f && cell.z >= 0.0f)
+         || ! (cell.x <= lastCell && cell.y <= lastCell && cell.z <= lastCell))
+        return false;
+
+    // The far edge of the grid uses the last cell, so the +1 neighbours always exist
+    const int x = jmin ((int)cell.x, mResolution - 2);
+    const int y = jmin ((int)cell.y, mResolution - 2);
+    const int z = jmin ((int)cell.z, mResolution - 2);
+
+    const float tx = cell.x - (float)x;
+    const float ty = cell.y - (float)y;
+    const float tz = cell.z - (float)z;
+
+    const float weights[8] = { (1.0f - tx) * (1.0f - ty) * (1.0f - tz),
+                               tx          * (1.0f - ty) * (1.0f - tz),
+                               (1.0f - tx) * ty          * (1.0f - tz),
+                               tx          * ty          * (1.0f - tz),
+                               (1.0f - tx) * (1.0f - ty) * tz,
+                               tx          * (1.0f - ty) * tz,
+                               (1.0f - tx) * ty          * tz,
+                               tx          * ty          * tz };
+
+    const float* corners[8] = { getPointGains (x,     y,     z),
+                                getPointGains (x + 1, y,     z),
+                                getPointGains (x,     y + 1, z),
+                                getPointGains (x + 1, y + 1, z),
+                                getPointGains (x,     y,     z + 1),
+                                getPointGains (x + 1, y,     z + 1),
+                                getPointGains (x,     y + 1, z + 1),
+                                getPointGains (x + 1, y + 1, z + 1) };
+
+    FloatVectorOperations::multiply (gains, corners[0], weights[0], numSpeakers);
+
+    for (int i = 1; i < 8; ++i)
+        FloatVectorOperations::addWithMultiply (gains, corners[i], weights[i], numSpeakers);
+
+    return true;
+}
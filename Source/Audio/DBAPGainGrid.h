@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    DBAPGainGrid.h
+    Created: 17 Oct 2026 8:24:37pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "vec3.hpp"
+
+/** The DBAP gains of every speaker, precomputed at the points of a regular 3D grid
+    over the speakers' bounding box.
+
+    Looking up a position interpolates between the 8 surrounding grid points, which
+    is a few multiply-adds per speaker instead of a distance, a pow and a divide.
+    The gains are only approximately normalised between grid points, so a finer grid
+    trades memory and build time for accuracy.
+*/
+class DBAPGainGrid
+{
+public:
+    /** Builds a grid with the given number of points along each axis. The build can
+        take a while for large layouts, so do it on a background thread. Returns nullptr
+        if shouldCancel returns true part way through.
+    */
+    static std::unique_ptr<DBAPGainGrid> build (const std::vector<glm::vec3>& speakerPositions,
+                                                int resolution,
+                                                const std::function<bool()>& shouldCancel);
+
+    /** Writes the interpolated gain of each speaker for the given position.
+        Returns false without writing anything if the position is outside the grid.
+    */
+    bool getGains (const glm::vec3& position, float* gains, int numSpeakers) const noexcept;
+
+    int getResolution() const noexcept          { return mResolution; }
+    int getNumSpeakers() const noexcept         { return mNumSpeakers; }
+    size_t getMemoryUsage() const noexcept      { return mGains.size() * sizeof (float); }
+
+    static constexpr int minResolution = 4;
+    static constexpr int maxResolution = 64;
+
+    // Layouts with a lot of speakers get a coarser grid rather than using more memory than this
+    static constexpr size_t maxNumGains = (size_t)1 << 25;
+
+private:
+    DBAPGainGrid() = default;
+
+    size_t getPointIndex (int x, int y, int z) const noexcept
+    {
+        return (size_t)((z * mResolution + y) * mResolution + x) * (size_t)mNumSpeakers;
+    }
+
+    const float* getPointGains (int x, int y, int z) const noexcept     { return mGains.data() + getPointIndex (x, y, z); }
+
+    int                 mResolution = 0;
+    int                 mNumSpeakers = 0;
+    glm::vec3           mMin;
+    glm::vec3           mCellSize;
+    glm::vec3           mInvCellSize;
+    std::vector<float>  mGains;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DBAPGainGrid)
+};
@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    LockFreeFifo.h
+    Created: 17 Oct 2026 4:18:22pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** A fixed size single producer, single consumer queue of copyable items.
+
+    One thread may push() and another may pop() at the same time without any
+    locking. Neither call allocates, so either side can be the audio thread.
+*/
+template <typename ItemType>
+class LockFreeFifo
+{
+public:
+    /** Creates a queue that can hold up to capacity items. */
+    explicit LockFreeFifo (int capacity)
+        : mFifo (capacity + 1),
+          mItems ((size_t)capacity + 1)
+    {
+    }
+
+    /** Adds an item, returning false if the queue is full.  (Producer only) */
+    bool push (const ItemType& item) noexcept
+    {
+        int start1, size1, start2, size2;
+        mFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+            return false;
+
+        mItems[(size_t)(size1 > 0 ? start1 : start2)] = item;
+        mFifo.finishedWrite (1);
+        return true;
+    }
+
+    /** Removes the oldest item, returning false if the queue is empty.  (Consumer only) */
+    bool pop (ItemType& item) noexcept
+    {
+        int start1, size1, start2, size2;
+        mFifo.prepareToRead (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+            return false;
+
+        item = mItems[(size_t)(size1 > 0 ? start1 : start2)];
+        mFifo.finishedRead (1);
+        return true;
+    }
+
+    int getNumReady() const noexcept        { return mFifo.getNumReady(); }
+    int getFreeSpace() const noexcept       { return mFifo.getFreeSpace(); }
+    int getCapacity() const noexcept        { return mFifo.getTotalSize() - 1; }
+
+private:
+    AbstractFifo            mFifo;
+    std::vector<ItemType>   mItems;
+
+    JUCE_DECLARE_NON_COPYABLE (LockFreeFifo)
+};
@@ -0,0 +1,163 @@
+/*
+  ==============================================================================
+
+    NoteIDMap.h
+    Created: 17 Oct 2026 10:12:40am
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** A fixed capacity hash map from (non-negative) noteIDs to values.
+
+    It uses open addressing with linear probing and backward shift deletion, so
+    there are no tombstones and lookups stay short however many notes come and go.
+    All the memory is allocated up front by prepare(), after which insert(), find()
+    and remove() never allocate or lock and can be called on the audio thread.
+*/
+template <typename ValueType>
+class NoteIDMap
+{
+public:
+    NoteIDMap()
+    {
+        prepare (16);
+    }
+
+    /** Allocates enough room for maxNumEntries keys and clears the map.
+        This allocates, so don't call it on the audio thread.
+    */
+    void prepare (int maxNumEntries)
+    {
+        // Keep the load factor at or below 0.5 so probe sequences stay short
+        const int capacity = nextPowerOfTwo (jmax (16, maxNumEntries * 2));
+
+        mEntries.assign ((size_t)capacity, Entry());
+        mMask = (uint32)capacity - 1;
+        mShift = 32 - (int)std::log2 ((double)capacity);
+        mMaxNumEntries = maxNumEntries;
+        mNumEntries = 0;
+    }
+
+    void clear() noexcept
+    {
+        for (auto& e : mEntries)
+            e = Entry();
+
+        mNumEntries = 0;
+    }
+
+    /** Maps a noteID to a value, replacing any existing value for that noteID.
+        Returns false if the map is full.
+    */
+    bool insert (int noteID, ValueType value) noexcept
+    {
+        jassert (noteID >= 0);
+
+        for (uint32 i = getIdealSlot (noteID);; i = (i + 1) & mMask)
+        {
+            auto& e = mEntries[i];
+
+            if (e.noteID == noteID)
+            {
+                e.value = value;
+                return true;
+            }
+
+            if (e.noteID == emptyKey)
+            {
+                if (mNumEntries >= mMaxNumEntries)
+                {
+                    jassertfalse; // prepare() wasn't given enough room
+                    return false;
+                }
+
+                e.noteID = noteID;
+                e.value = value;
+                ++mNumEntries;
+                return true;
+            }
+        }
+    }
+
+    /** Returns a pointer to the value for a noteID, or nullptr if it isn't mapped. */
+    const ValueType* find (int noteID) const noexcept
+    {
+        if (noteID < 0)
+            return nullptr;
+
+        for (uint32 i = getIdealSlot (noteID);; i = (i + 1) & mMask)
+        {
+            const auto& e = mEntries[i];
+
+            if (e.noteID == noteID)
+                return &e.value;
+
+            if (e.noteID == emptyKey)
+                return nullptr;
+        }
+    }
+
+    /** Unmaps a noteID, returning true if it was in the map. */
+    bool remove (int noteID) noexcept
+    {
+        if (noteID < 0)
+            return false;
+
+        uint32 hole = getIdealSlot (noteID);
+
+        while (mEntries[hole].noteID != noteID)
+        {
+            if (mEntries[hole].noteID == emptyKey)
+                return false;
+
+            hole = (hole + 1) & mMask;
+        }
+
+        // Shift later members of the probe sequence back into the hole so
+        // that every remaining key is still reachable from its ideal slot
+        for (uint32 next = (hole + 1) & mMask; mEntries[next].noteID != emptyKey; next = (next + 1) & mMask)
+        {
+            const uint32 ideal = getIdealSlot (mEntries[next].noteID);
+            const uint32 distToNext = (next - ideal) & mMask;
+            const uint32 distToHole = (hole - ideal) & mMask;
+
+            if (distToHole <= distToNext)
+            {
+                mEntries[hole] = mEntries[next];
+                hole = next;
+            }
+        }
+
+        mEntries[hole] = Entry();
+        --mNumEntries;
+        return true;
+    }
+
+    int size() const noexcept                   { return mNumEntries; }
+
+private:
+    static constexpr int emptyKey = -1;
+
+    struct Entry
+    {
+        int       noteID = emptyKey;
+        ValueType value {};
+    };
+
+    uint32 getIdealSlot (int noteID) const noexcept
+    {
+        // Fibonacci hashing spreads the typically sequential noteIDs over the table
+        return ((uint32)noteID * 2654435769u) >> mShift;
+    }
+
+    std::vector<Entry>  mEntries;
+    uint32              mMask = 0;
+    int                 mShift = 32;
+    int                 mMaxNumEntries = 0;
+    int                 mNumEntries = 0;
+};
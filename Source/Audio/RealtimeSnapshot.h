@@ -0,0 +1,143 @@
+/*
+  ==============================================================================
+
+    RealtimeSnapshot.h
+    Created: 17 Oct 2026 4:26:47pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "LockFreeFifo.h"
+
+/** Hands immutable (or audio thread owned) objects from the message thread to
+    the audio thread without locking.
+
+    The message thread builds a complete new object and publish()es it. At the start
+    of each block the audio thread calls update(), which atomically takes the latest
+    published object and uses it from then on. The object it replaces is passed back
+    through a lock-free queue and deleted by releaseRetiredObjects() on the message
+    thread, so nothing is ever allocated or freed on the audio thread.
+
+    The reading side doesn't have to be the audio thread, any single thread that
+    needs to read without locking can take its place.
+*/
+template <typename ObjectType>
+class RealtimeSnapshot
+{
+public:
+    RealtimeSnapshot()
+    {
+    }
+
+    ~RealtimeSnapshot()
+    {
+        delete mPending.exchange (nullptr);
+        delete mCurrent;
+
+        ObjectType* retired = nullptr;
+
+        while (mRetired.pop (retired))
+            delete retired;
+    }
+
+    //==============================================================================
+    /** Queues an object to replace the current one.  (Message thread only)
+
+        If the audio thread hasn't picked up the previously published object yet, that
+        object is deleted straight away as it can never have been used.
+    */
+    void publish (std::unique_ptr<ObjectType> newObject)
+    {
+        jassert (newObject != nullptr);
+
+        delete mPending.exchange (newObject.release());
+        releaseRetiredObjects();
+    }
+
+    /** Deletes any objects the audio thread has finished with.  (Message thread only) */
+    void releaseRetiredObjects()
+    {
+        ObjectType* retired = nullptr;
+
+        while (mRetired.pop (retired))
+            delete retired;
+    }
+
+    /** Takes the next object the audio thread has finished with, if there is one, so
+        the caller can decide when to delete it.  (Message thread only)
+    */
+    std::unique_ptr<ObjectType> takeRetiredObject()
+    {
+        ObjectType* retired = nullptr;
+        mRetired.pop (retired);
+        return std::unique_ptr<ObjectType> (retired);
+    }
+
+    //==============================================================================
+    /** Switches to the most recently published object, if there is one.
+        Returns true if the current object changed.  (Audio thread only)
+    */
+    bool update() noexcept
+    {
+        if (mPending.load() == nullptr)
+            return false;
+
+        // If the message thread hasn't cleared the retired queue, keep the
+        // current object for another block rather than leaking it
+        if (mCurrent != nullptr && mRetired.getFreeSpace() == 0)
+            return false;
+
+        auto* newObject = mPending.exchange (nullptr);
+
+        if (newObject == nullptr)
+            return false;
+
+        if (mCurrent != nullptr)
+            mRetired.push (mCurrent);
+
+        mCurrent = newObject;
+        return true;
+    }
+
+    /** Like update(), but hands the replaced object (which may be nullptr) back to the
+        caller instead of retiring it, so it can carry on being used for a while. It must
+        eventually be passed to retire().  (Audio thread only)
+    */
+    bool update (ObjectType*& replacedObject) noexcept
+    {
+        auto* newObject = mPending.exchange (nullptr);
+
+        if (newObject == nullptr)
+            return false;
+
+        replacedObject = mCurrent;
+        mCurrent = newObject;
+        return true;
+    }
+
+    /** Passes an object taken with update (ObjectType*&) back to the message thread to
+        be deleted. Returns false if the queue is full, in which case try again later.
+        (Audio thread only)
+    */
+    bool retire (ObjectType* objectToRetire) noexcept
+    {
+        return objectToRetire == nullptr || mRetired.push (objectToRetire);
+    }
+
+    /** Returns true if the queue of objects waiting to be deleted has room. */
+    bool canRetire() const noexcept             { return mRetired.getFreeSpace() > 0; }
+
+    /** Returns the object in use, or nullptr if nothing has been published yet.  (Audio thread only) */
+    ObjectType* get() const noexcept            { return mCurrent; }
+    ObjectType* operator->() const noexcept     { return mCurrent; }
+
+private:
+    std::atomic<ObjectType*>    mPending { nullptr };
+    ObjectType*                 mCurrent = nullptr;
+    LockFreeFifo<ObjectType*>   mRetired { 32 };
+
+    JUCE_DECLARE_NON_COPYABLE (RealtimeSnapshot)
+};
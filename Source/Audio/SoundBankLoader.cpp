@@ -0,0 +1,322 @@
+/*
+  ==============================================================================
+
+    SoundBankLoader.cpp
+    Created: 17 Oct 2026 5:12:40pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "SoundBankLoader.h"
+
+
+//==============================================================================
+SoundBankLoader::SoundBankLoader (TimeSliceThread& readAheadThread)
+    : Thread ("Sound Bank Loader"),
+      mDecodePool (SystemStats::getNumCpus()),
+      mReadAheadThread (readAheadThread)
+{
+    mFormatManager.registerBasicFormats();
+}
+
+SoundBankLoader::~SoundBankLoader()
+{
+    stopThread (10000);
+    cancelPendingUpdate();
+}
+
+void SoundBankLoader::loadFolders (const File& clipFolder, const File& atmosphereFolder)
+{
+    {
+        const ScopedLock sl (mRequestLock);
+        mClipFolder = clipFolder;
+        mAtmosphereFolder = atmosphereFolder;
+        ++mLatestRequest;
+    }
+
+    // Decoding checks isLoadCancelled() between files, so an older load gives up by itself
+    if (! isThreadRunning())
+        startThread();
+
+    notify();
+}
+
+bool SoundBankLoader::isLoadCancelled() const
+{
+    return threadShouldExit() || mLatestRequest.load() != mLoadingRequest;
+}
+
+//==============================================================================
+void SoundBankLoader::run()
+{
+    while (! threadShouldExit())
+    {
+        File clipFolder, atmosphereFolder;
+
+        {
+            const ScopedLock sl (mRequestLock);
+            mLoadingRequest = mLatestRequest.load();
+            clipFolder = mClipFolder;
+            atmosphereFolder = mAtmosphereFolder;
+        }
+
+        auto bank = loadBank (clipFolder, atmosphereFolder);
+
+        if (bank != nullptr)
+        {
+            {
+                const ScopedLock sl (mLoadedBankLock);
+                mLoadedBank = std::move (bank);
+                mLoadedBankRequest = mLoadingRequest;
+            }
+
+            triggerAsyncUpdate();
+        }
+
+        // Sleep until the next request, unless one came in while loading
+        if (mLatestRequest.load() == mLoadingRequest)
+            wait (-1);
+    }
+}
+
+void SoundBankLoader::handleAsyncUpdate()
+{
+    std::unique_ptr<SoundBank> bank;
+    int request = 0;
+
+    {
+        const ScopedLock sl (mLoadedBankLock);
+        bank = std::move (mLoadedBank);
+        request = mLoadedBankRequest;
+    }
+
+    // A bank for folders that have since been replaced is thrown away
+    if (bank != nullptr && request == mLatestRequest.load() && onBankLoaded != nullptr)
+        onBankLoaded (std::move (bank));
+}
+
+bool SoundBankLoader::runInParallel (int numJobs, const std::function<void(int)>& job)
+{
+    for (int i = 0; i < numJobs; ++i)
+    {
+        mDecodePool.addJob ([this, i, &job]
+        {
+            // Once cancelled, the remaining jobs drain straight away
+            if (! isLoadCancelled())
+                job (i);
+        });
+    }
+
+    // The jobs refer to the caller's locals, so they all have to finish even when cancelled
+    while (mDecodePool.getNumJobs() > 0)
+        wait (5);
+
+    return ! isLoadCancelled();
+}
+
+Array<File> SoundBankLoader::findAudioFiles (const File& folder) const
+{
+    Array<File> audioFiles;
+
+    for (auto& file : folder.findChildFiles(File::TypesOfFileToFind::findFiles, false))
+        if (mFormatManager.findFormatForFileExtension(file.getFileExtension()) != nullptr)
+            audioFiles.add(file);
+
+    // Sorted so that the sound indices are the same every time the folder is loaded
+    audioFiles.sort();
+    return audioFiles;
+}
+
+std::unique_ptr<SoundBank> SoundBankLoader::loadBank (const File& clipFolder, const File& atmosphereFolder)
+{
+    auto bank = std::make_unique<SoundBank>();
+    const double loadStartTime = Time::getMillisecondCounterHiRes();
+    double stageStartTime = loadStartTime;
+
+    auto logStage = [&stageStartTime](const String& stage, int numFiles)
+    {
+        const double now = Time::getMillisecondCounterHiRes();
+        Logger::getCurrentLogger()->writeToLog("Sound bank " + stage + ": " + String(numFiles) + " files in "
+                                               + String(now - stageStartTime, 1) + "ms");
+        stageStartTime = now;
+    };
+
+    auto atmosphereFiles = findAudioFiles(atmosphereFolder);
+    auto clipFiles = findAudioFiles(clipFolder);
+    logStage("scan", atmosphereFiles.size() + clipFiles.size());
+
+    if (clipFiles.size() == 0)
+    {
+        Logger::getCurrentLogger()->writeToLog("Failed to find any .wavs");
+    }
+
+    // Decode every file into its own slot so the results keep the folder order
+    std::vector<std::unique_ptr<AudioFileSource>> atmosphereSlots((size_t)atmosphereFiles.size());
+    std::vector<SpatialSynthSound::Ptr> clipSlots((size_t)clipFiles.size());
+    std::vector<double> fileLengths((size_t)(atmosphereFiles.size() + clipFiles.size()), 0.0);
+    const int64 streamingThreshold = mStreamingThreshold.load();
+
+    // Clips that haven't changed since they were cached are mapped rather than decoded
+    const bool useClipCache = mUseClipCache.load();
+    ClipSampleCache::Ptr clipCache;
+    std::vector<int> clipCacheEntries((size_t)clipFiles.size(), -1);
+
+    if (useClipCache)
+        clipCache = ClipSampleCache::open(clipFolder);
+
+    const bool decoded = runInParallel(atmosphereFiles.size() + clipFiles.size(), [&](int i)
+    {
+        const bool isAtmosphere = i < atmosphereFiles.size();
+        const int clipIndex = i - atmosphereFiles.size();
+        const auto& file = isAtmosphere ? atmosphereFiles.getReference(i)
+                                        : clipFiles.getReference(clipIndex);
+
+        if (! isAtmosphere && clipCache != nullptr)
+        {
+            const int entryIndex = clipCache->findEntry(file);
+            clipCacheEntries[(size_t)clipIndex] = entryIndex;
+
+            if (entryIndex >= 0)
+            {
+                if (clipCache->getSamples(entryIndex) != nullptr)
+                {
+                    fileLengths[(size_t)i] = clipCache->getEntry(entryIndex).fileLength;
+                    clipSlots[(size_t)clipIndex] = new SpatialSamplerSound(file.getFileNameWithoutExtension(), clipCache, entryIndex, -1, 0.01, 0.5);
+                }
+
+                return;
+            }
+        }
+
+        std::unique_ptr<AudioFormatReader> reader(mFormatManager.createReaderFor(file));
+
+        if (reader == nullptr)
+            return;
+
+        const auto name = file.getFileNameWithoutExtension();
+        fileLengths[(size_t)i] = (double)reader->lengthInSamples / (double)reader->sampleRate;
+
+        const int64 decodedSize = reader->lengthInSamples * (int64)reader->numChannels * (int64)sizeof(float);
+
+        if (isAtmosphere && streamingThreshold > 0 && decodedSize > streamingThreshold)
+            atmosphereSlots[(size_t)i].reset(new AudioFileSource(name, std::move(reader), mReadAheadThread));
+        else if (isAtmosphere)
+            atmosphereSlots[(size_t)i].reset(new AudioFileSource(name, *reader));
+        else
+            clipSlots[(size_t)clipIndex] = new SpatialSamplerSound(name, *reader, -1, 0.01, 0.5, 20.0);
+    });
+
+    if (! decoded)
+        return nullptr;
+
+    const int numCachedClips = (int)std::count_if(clipCacheEntries.begin(), clipCacheEntries.end(), [](int e) { return e >= 0; });
+    logStage("decode (" + String(numCachedClips) + " clips from cache)", atmosphereFiles.size() + clipFiles.size() - numCachedClips);
+
+    // Drop any files that couldn't be read, keeping the rest in order. The clips are
+    // numbered afterwards so that each noteID is the clip's index in the bank
+    Array<double> atmosphereLengths, clipLengths;
+    Array<File> loadedAtmosphereFiles;
+    Array<int> loadedClipCacheEntries;
+    std::vector<int> loadedClipIndices((size_t)clipFiles.size(), -1);
+
+    for (size_t i = 0; i < atmosphereSlots.size(); ++i)
+    {
+        if (atmosphereSlots[i] != nullptr)
+        {
+            bank->mAtmospheres.push_back(std::move(atmosphereSlots[i]));
+            atmosphereLengths.add(fileLengths[i]);
+            loadedAtmosphereFiles.add(atmosphereFiles[(int)i]);
+        }
+    }
+
+    for (size_t i = 0; i < clipSlots.size(); ++i)
+    {
+        if (clipSlots[i] != nullptr)
+        {
+            loadedClipIndices[i] = bank->mClipSounds.size();
+            static_cast<SpatialSamplerSound*>(clipSlots[i].get())->setNoteID(bank->mClipSounds.size());
+            bank->mClipSounds.add(clipSlots[i]);
+            clipLengths.add(fileLengths[atmosphereSlots.size() + i]);
+            loadedClipCacheEntries.add(clipCacheEntries[i]);
+        }
+    }
+
+    // Build the waveform overviews for the UI
+    const int numAtmospheres = (int)bank->mAtmospheres.size();
+    const int numClips = bank->mClipSounds.size();
+    std::vector<std::unique_ptr<SoundFileData>> fileData((size_t)(numAtmospheres + numClips));
+
+    const bool analysed = runInParallel(numAtmospheres + numClips, [&](int i)
+    {
+        if (i < numAtmospheres)
+        {
+            const auto& source = *bank->mAtmospheres[(size_t)i];
+
+            if (! source.isStreaming())
+            {
+                fileData[(size_t)i].reset(new SoundFileData(source.getName(), *source.getAudioData(), atmosphereLengths[i], i));
+            }
+            else
+            {
+                // The streaming source's reader belongs to the read ahead thread, so open another
+                std::unique_ptr<AudioFormatReader> reader(mFormatManager.createReaderFor(loadedAtmosphereFiles[i]));
+
+                if (reader != nullptr)
+                    fileData[(size_t)i].reset(new SoundFileData(source.getName(), *reader, atmosphereLengths[i], i));
+                else
+                    fileData[(size_t)i].reset(new SoundFileData(source.getName(), AudioBuffer<float>(1, 1), atmosphereLengths[i], i));
+            }
+        }
+        else
+        {
+            const int clipIndex = i - numAtmospheres;
+            const int cacheEntry = loadedClipCacheEntries[clipIndex];
+            auto* sound = static_cast<SpatialSamplerSound*>(bank->mClipSounds.getObjectPointerUnchecked(clipIndex));
+
+            if (cacheEntry >= 0)
+                fileData[(size_t)i].reset(new SoundFileData(sound->getName(), clipCache->getEntry(cacheEntry).waveform, clipLengths[clipIndex], clipIndex));
+            else
+                fileData[(size_t)i].reset(new SoundFileData(sound->getName(), *sound->getAudioData(), clipLengths[clipIndex], clipIndex));
+        }
+    });
+
+    if (! analysed)
+        return nullptr;
+
+    logStage("analysis", numAtmospheres + numClips - numCachedClips);
+
+    // Rewrite the cache if any clips were added, changed or removed
+    const bool cacheIsStale = clipCache == nullptr
+                               || numCachedClips < clipFiles.size()
+                               || clipCache->getNumEntries() != clipFiles.size();
+
+    if (useClipCache && cacheIsStale && clipFiles.size() > 0)
+    {
+        std::vector<ClipSampleCache::SourceClip> cacheClips(clipSlots.size());
+
+        for (size_t i = 0; i < clipSlots.size(); ++i)
+        {
+            if (auto* sound = static_cast<SpatialSamplerSound*>(clipSlots[i].get()))
+            {
+                cacheClips[i].sampleRate = sound->getSourceSampleRate();
+                cacheClips[i].fileLength = fileLengths[atmosphereSlots.size() + i];
+                cacheClips[i].monoData = sound->getAudioData();
+                cacheClips[i].waveform = &fileData[(size_t)(numAtmospheres + loadedClipIndices[i])]->mWaveform;
+            }
+        }
+
+        // This can fail on Windows while the old cache is still mapped, it is retried on the next load
+        if (! ClipSampleCache::write(clipFolder, clipFiles, cacheClips))
+            Logger::getCurrentLogger()->writeToLog("Failed to write the clip cache for " + clipFolder.getFullPathName());
+
+        logStage("cache write", clipFiles.size());
+    }
+
+    for (int i = 0; i < numAtmospheres + numClips; ++i)
+        (i < numAtmospheres ? bank->mAtmosphereData : bank->mClipData).push_back(std::move(*fileData[(size_t)i]));
+
+    Logger::getCurrentLogger()->writeToLog("Sound bank loaded in " + String(Time::getMillisecondCounterHiRes() - loadStartTime, 1)
+                                           + "ms using " + String(mDecodePool.getNumThreads()) + " threads");
+    return bank;
+}
@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    SoundBankLoader.h
+    Created: 17 Oct 2026 5:12:40pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include "SpatialSampler.h"
+#include "AudioFileSource.h"
+#include "../State/AudioDataState.h"
+
+/** Everything decoded from a clip folder and an atmosphere folder, ready to be
+    handed over to the audio engine in one go.
+*/
+struct SoundBank
+{
+    ReferenceCountedArray<SpatialSynthSound>        mClipSounds;
+    std::vector<std::unique_ptr<AudioFileSource>>   mAtmospheres;
+
+    // Display data for the UI, built alongside the audio
+    std::vector<SoundFileData>                      mClipData;
+    std::vector<SoundFileData>                      mAtmosphereData;
+};
+
+/** Decodes sound banks on a background thread so that changing folders never
+    blocks the audio or message threads.
+
+    Atmospheres larger than the streaming threshold aren't decoded, but are streamed
+    from disk using the read ahead thread.
+
+    Each finished bank is passed to onBankLoaded on the message thread. Starting a new
+    load abandons any that is still in progress, without waiting for it to stop.
+*/
+class SoundBankLoader  : private Thread,
+                         private AsyncUpdater
+{
+public:
+    SoundBankLoader(TimeSliceThread& readAheadThread);
+    ~SoundBankLoader() override;
+
+    /** Sets the decoded size in bytes above which atmospheres are streamed rather
+        than loaded into memory. 0 loads everything. Applies from the next load.
+    */
+    void setStreamingThreshold (int64 numBytes)         { mStreamingThreshold = numBytes; }
+
+    /** If enabled, the decoded clips are written to a ClipSampleCache and mapped from
+        it on later loads instead of being decoded again. Applies from the next load.
+    */
+    void setUseClipCache (bool shouldUseCache)          { mUseClipCache = shouldUseCache; }
+
+    /** Starts loading the files in the given folders.  (Message thread only)
+        This returns straight away. A load that is still running stops at the next file,
+        and its bank is thrown away if it finishes anyway.
+    */
+    void loadFolders (const File& clipFolder, const File& atmosphereFolder);
+
+    /** Called on the message thread with each completed bank. */
+    std::function<void(std::unique_ptr<SoundBank>)> onBankLoaded;
+
+private:
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    /** Returns nullptr if the load was cancelled part way through. */
+    std::unique_ptr<SoundBank> loadBank (const File& clipFolder, const File& atmosphereFolder);
+
+    /** True if the thread is stopping or a newer load has been requested. */
+    bool isLoadCancelled() const;
+
+    /** Returns the files in the folder that have a known audio format, sorted by name. */
+    Array<File> findAudioFiles (const File& folder) const;
+
+    /** Calls job (i) for each index from 0 to numJobs - 1 on the decoding threads and waits
+        for them all. Returns false if the load was cancelled before they finished.
+    */
+    bool runInParallel (int numJobs, const std::function<void(int)>& job);
+
+    AudioFormatManager          mFormatManager;
+
+    // Sized to the core count, files are decoded and analysed in parallel on these
+    ThreadPool                  mDecodePool;
+
+    TimeSliceThread&            mReadAheadThread;
+    std::atomic<int64>          mStreamingThreshold { 0 };
+    std::atomic<bool>           mUseClipCache { false };
+
+    // The latest request. The thread always loads the newest one, and
+    // mLoadingRequest is the one it's working on
+    CriticalSection             mRequestLock;
+    File                        mClipFolder;
+    File                        mAtmosphereFolder;
+    std::atomic<int>            mLatestRequest { 0 };
+    int                         mLoadingRequest = 0;
+
+    CriticalSection             mLoadedBankLock;
+    std::unique_ptr<SoundBank>  mLoadedBank;
+    int                         mLoadedBankRequest = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SoundBankLoader)
+};
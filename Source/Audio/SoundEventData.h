@@ -10,71 +10,481 @@
 
 #pragma once
 
+#include "NoteIDMap.h"
+#include "vec3.hpp"
 
 struct SoundEvent
 {
     int          noteID = 0;
     int          soundID = -1;
     glm::vec3    position;
-    
+
+    // When the event should be heard, in Time::getMillisecondCounterHiRes() time.
+    // Events left at 0 are played one block after they are added.
+    double       time = 0.0;
+
+    // Set on the audio thread to the event's position in the block being rendered
+    int          sampleOffset = 0;
+
     bool isStartNote() const { return soundID >= 0; }
 };
 
 
-/** This structure manages the passing of event messages from the message
-    thread onto the audio thread in a lock free way.
+/** This structure manages the passing of event messages from the OSC receive
+    thread (and any other threads that create a Producer) onto the audio thread in
+    a lock free way.
+
+    Each producer has its own single producer, single consumer fifo, so adding an
+    event never waits on another producer. The audio thread merges the fifos into
+    one time ordered list, and events from the same producer keep their order.
+
+    Each event is scheduled for a time rather than just the next block. Events
+    without a time are delayed by one block, so that the jitter of when they arrive
+    relative to the audio callback doesn't become jitter in when they are heard.
+
+    Position updates for the same note within one block are merged into a single
+    update with the latest position, so fast trackers don't cost a DBAP update each.
+
+    If events arrive faster than they can be queued, position updates are dropped
+    (oldest first) to make room. The end of each fifo is kept for start events, so a
+    start is only dropped once its producer's fifo is completely full. Adding an event
+    never blocks: a dropped start is reported back to the producer straight away, and
+    every drop is counted, see getStatistics().
 */
 struct SoundEventData
 {
+private:
+    struct EventRing
+    {
+        EventRing() : fifo(minCapacity) {}
+
+        AbstractFifo            fifo;
+        std::vector<SoundEvent> buffer;
+        std::atomic<bool>       isClaimed { false };
+    };
+
 public:
-    SoundEventData()
-        : mFifo(FIFO_SIZE)
+    explicit SoundEventData(int capacity = defaultCapacity)
+    {
+        setCapacity(capacity);
+    }
+
+    static constexpr int defaultCapacity = 2048;
+    static constexpr int minCapacity = 64;
+    static constexpr int maxCapacity = 65536;
+    // The fifos are allocated up front, so only this many producers can exist at once
+    static constexpr int maxNumProducers = 8;
+
+    // Timestamps further ahead than this are assumed to come from a badly synced clock
+    static constexpr double maxScheduleAheadMs = 10000.0;
+
+    //==============================================================================
+    /** Adds events from one thread. Each thread that adds events needs a producer of
+        its own, which it can then use without locking or waiting on the others.
+    */
+    class Producer
+    {
+    public:
+        ~Producer()
+        {
+            // Anything still in the fifo is played as normal
+            mRing.isClaimed = false;
+        }
+
+        /** Queues an event without waiting. Returns false if it was dropped because the
+            fifo was full, in which case it's up to the caller whether to try again later.
+        */
+        bool addSoundEvent(const SoundEvent& event)     { return mOwner.addSoundEvent(event, mRing); }
+
+    private:
+        friend struct SoundEventData;
+
+        Producer(SoundEventData& owner, EventRing& ring)
+            : mOwner(owner), mRing(ring)
+        {
+        }
+
+        SoundEventData& mOwner;
+        EventRing&      mRing;
+
+        JUCE_DECLARE_NON_COPYABLE (Producer)
+    };
+
+    /** Returns a new producer, or nullptr if maxNumProducers (8) are already in use.
+
+        Each producer has a fifo of getCapacity() events to itself, and only
+        maxNumProducers fifos exist, so producers are meant for long lived threads
+        like the OSC receiver rather than for one-off jobs. Deleting a producer makes
+        its fifo available again. It must be deleted before this object is.  (Any thread)
+    */
+    std::unique_ptr<Producer> createProducer()
+    {
+        for (auto& ring : mRings)
+        {
+            bool wasClaimed = false;
+
+            if (ring.isClaimed.compare_exchange_strong(wasClaimed, true))
+                return std::unique_ptr<Producer>(new Producer(*this, ring));
+        }
+
+        jassertfalse; // Too many threads are adding events
+        return nullptr;
+    }
+
+    //==============================================================================
+    /** Sets how many events can be waiting to be played, per producer.  (Call before the
+        audio thread starts and events are added, any events already queued are lost)
+    */
+    void setCapacity(int newCapacity)
     {
-        for (int i = 0; i < FIFO_SIZE; ++i)
+        newCapacity = jlimit(minCapacity, maxCapacity, newCapacity);
+
+        for (auto& ring : mRings)
         {
-            mEventBuffer[i].noteID = 0;
-            mEventBuffer[i].soundID = -1;
-            mEventBuffer[i].position = glm::vec3(0.0f);
+            ring.fifo.setTotalSize(newCapacity);
+            ring.buffer.assign((size_t)newCapacity, SoundEvent());
         }
+
+        mPendingStarts.reset(newCapacity);
+        mPendingUpdates.reset(newCapacity);
+        mBlockEvents.clear();
+        mBlockEvents.reserve((size_t)newCapacity);
+        mBlockUpdateIndices.prepare(newCapacity);
+
+        // The end of the fifo is kept free for start events
+        mStartReserve = newCapacity / 8;
+        mCapacity = newCapacity;
+    }
+
+    int getCapacity() const noexcept                            { return mCapacity; }
+
+    void prepareToPlay(double sampleRate, int samplesPerBlockExpected) // Called before the audio thread starts
+    {
+        mSampleRate = sampleRate;
+        mSchedulingLatencyMs = 1000.0 * samplesPerBlockExpected / sampleRate;
+        mBlockStartTime = 0.0;
+    }
+
+    struct Statistics
+    {
+        int     capacity = 0;
+        int     highWaterMark = 0;          // The most events that have been waiting at once
+        uint32  numDroppedUpdates = 0;
+        uint32  numDroppedStarts = 0;       // Only once a producer's whole fifo is full
+    };
+
+    Statistics getStatistics() const noexcept
+    {
+        Statistics stats;
+        stats.capacity = mCapacity;
+        stats.highWaterMark = mHighWaterMark.load();
+        stats.numDroppedUpdates = mNumDroppedUpdates.load();
+        stats.numDroppedStarts = mNumDroppedStarts.load();
+        return stats;
     }
-    
-    static constexpr int FIFO_SIZE = 2048;
 
-    void addSoundEvent(const SoundEvent& newEvent) // Message Thread Accessible
+    void resetHighWaterMark() noexcept                          { mHighWaterMark = 0; }
+
+    /** If true (the default) merged position updates take effect at the first of the
+        updates, and the voice's gain ramps smoothly to the last position over the rest of
+        the block. If false they take effect at the time of the last update.
+    */
+    void setInterpolateMergedUpdates(bool shouldInterpolate)    { mInterpolateMergedUpdates = shouldInterpolate; }
+
+    /** Returns how many position updates have been merged into later ones. */
+    uint32 getNumMergedUpdates() const noexcept                 { return mNumMergedUpdates.load(); }
+
+    /** Returns the events that are due in the next numSamples, in time order, with their
+        sampleOffset set. Events that are due later are kept until their block comes round.
+    */
+    const std::vector<SoundEvent>& getEventsForNextBlock(int numSamples) // Audio Thread Accessible
     {
-        jassert (juce::MessageManager::getInstance()->isThisTheMessageThread());
+        jassert(mSampleRate > 0.0);
+
+        const double msPerSample = 1000.0 / mSampleRate;
+        updateBlockStartTime(Time::getMillisecondCounterHiRes());
+
+        // At most the capacity of the pending lists is read each block, starting from a
+        // different fifo each time so a busy producer can't hold up the others. Events
+        // that aren't read, or start events that don't fit, wait in their fifo
+        int numToRead = mCapacity;
+        int numQueued = 0;
+
+        for (int i = 0; i < maxNumProducers; ++i)
+        {
+            auto& ring = mRings[(mFirstRingToRead + i) % maxNumProducers];
+
+            if (numToRead > 0)
+                numToRead = readEvents(ring, numToRead);
+
+            numQueued += ring.fifo.getNumReady();
+        }
+
+        mFirstRingToRead = (mFirstRingToRead + 1) % maxNumProducers;
+        updateHighWaterMark(mPendingStarts.size() + mPendingUpdates.size() + numQueued);
+
+        // The pending lists are in time order, so stop at the first event after this block
+        mBlockEvents.clear();
+
+        const bool interpolate = mInterpolateMergedUpdates.load();
+        int numMerged = 0;
+
+        for (;;)
+        {
+            // Take the earlier of the two lists' first events, starts first if they tie
+            const bool hasStart = ! mPendingStarts.isEmpty();
+            const bool hasUpdate = ! mPendingUpdates.isEmpty();
+
+            if (! hasStart && ! hasUpdate)
+                break;
+
+            auto& list = hasStart && (! hasUpdate || mPendingStarts.front().time <= mPendingUpdates.front().time)
+                           ? mPendingStarts : mPendingUpdates;
+
+            SoundEvent event = list.front();
+            const int offset = (int)std::floor((event.time - mBlockStartTime) / msPerSample);
+
+            if (offset >= numSamples)
+                break;
+
+            list.popFront();
+
+            // Late events are played at the start of the block
+            event.sampleOffset = jmax(0, offset);
+
+            if (event.noteID >= 0 && event.isStartNote())
+            {
+                // Updates after a restart mustn't be merged into ones for the previous note
+                mBlockUpdateIndices.remove(event.noteID);
+            }
+            else if (event.noteID >= 0)
+            {
+                if (auto* index = mBlockUpdateIndices.find(event.noteID))
+                {
+                    auto& merged = mBlockEvents[(size_t)*index];
+                    ++numMerged;
+
+                    if (interpolate)
+                    {
+                        merged.position = event.position;
+                        continue;
+                    }
+
+                    // Drop the earlier update, the list is compacted below
+                    merged.soundID = mergedUpdateID;
+                }
+
+                mBlockUpdateIndices.insert(event.noteID, (int)mBlockEvents.size());
+            }
+
+            mBlockEvents.push_back(event);
+        }
+
+        mBlockStartTime += numSamples * msPerSample;
+
+        for (const auto& event : mBlockEvents)
+            mBlockUpdateIndices.remove(event.noteID);
+
+        if (numMerged > 0)
+        {
+            if (! interpolate)
+                mBlockEvents.erase(std::remove_if(mBlockEvents.begin(), mBlockEvents.end(),
+                                                  [](const SoundEvent& e) { return e.soundID == mergedUpdateID; }),
+                                   mBlockEvents.end());
+
+            mNumMergedUpdates += (uint32)numMerged;
+        }
+
+        return mBlockEvents;
+    }
+
+private:
+    bool addSoundEvent(const SoundEvent& newEvent, EventRing& ring) // Only the ring's producer
+    {
+        const double now = Time::getMillisecondCounterHiRes();
+
+        SoundEvent event = newEvent;
+        event.time = event.time > 0.0 ? jmin(event.time, now + maxScheduleAheadMs)
+                                      : now + mSchedulingLatencyMs.load();
+
+        if (event.isStartNote() && ring.fifo.getFreeSpace() == 0)
+        {
+            ++mNumDroppedStarts;
+            return false;
+        }
+
+        // Updates can't use the space kept for start events, so they're always dropped first
+        if (! event.isStartNote() && ring.fifo.getFreeSpace() <= mStartReserve)
+        {
+            ++mNumDroppedUpdates;
+            return false;
+        }
 
         int start1, size1, start2, size2;
-        mFifo.prepareToWrite(1, start1, size1, start2, size2);
+        ring.fifo.prepareToWrite(1, start1, size1, start2, size2);
 
         if (size1 > 0)
-            mEventBuffer[start1] = newEvent;
+            ring.buffer[(size_t)start1] = event;
         else if (size2 > 0)
-            mEventBuffer[start2] = newEvent;
+            ring.buffer[(size_t)start2] = event;
 
-        mFifo.finishedWrite(size1 + size2);
+        ring.fifo.finishedWrite(size1 + size2);
+        updateHighWaterMark(ring.fifo.getNumReady());
+        return true;
     }
-    
-    void processEventData()                           // Audio Thread Accessible
+
+    // Moves up to maxNumEvents of the ring's events into the pending lists, and returns
+    // how many more can be read this block. That's 0 once the lists are full of start events.
+    int readEvents(EventRing& ring, int maxNumEvents)
     {
-        jassert(onProcessEvent != nullptr);
-        
         int start1, size1, start2, size2;
-        mFifo.prepareToRead(FIFO_SIZE, start1, size1, start2, size2);
+        ring.fifo.prepareToRead(jmin(maxNumEvents, ring.fifo.getNumReady()), start1, size1, start2, size2);
+        int numRead = 0;
 
-        for (int i = 0; i != size1; ++i)
-            onProcessEvent(mEventBuffer[start1 + i]);
+        for (; numRead < size1 + size2; ++numRead)
+        {
+            const int index = numRead < size1 ? start1 + numRead : start2 + numRead - size1;
 
-        for (int i = 0; i != size2; ++i)
-            onProcessEvent(mEventBuffer[start2 + i]);
+            if (! addPendingEvent(ring.buffer[(size_t)index]))
+            {
+                ring.fifo.finishedRead(numRead);
+                return 0;
+            }
+        }
 
-        mFifo.finishedRead(size1 + size2);
+        ring.fifo.finishedRead(numRead);
+        return maxNumEvents - numRead;
     }
-    
-    std::function<void(const SoundEvent& e)> onProcessEvent;
 
-private:
-    juce::AbstractFifo mFifo;
-    SoundEvent         mEventBuffer[FIFO_SIZE];
-    
+    // Returns false if the event couldn't be added because the lists are full of start events
+    bool addPendingEvent(const SoundEvent& event)
+    {
+        if (mPendingStarts.size() + mPendingUpdates.size() >= mCapacity)
+        {
+            // Make room by dropping the oldest position update, which is first in its list
+            const bool eventIsOldest = mPendingUpdates.isEmpty() || event.time < mPendingUpdates.front().time;
+
+            if (! event.isStartNote() && eventIsOldest)
+            {
+                ++mNumDroppedUpdates;
+                return true;
+            }
+
+            if (mPendingUpdates.isEmpty())
+                return false;
+
+            mPendingUpdates.popFront();
+            ++mNumDroppedUpdates;
+        }
+
+        if (event.isStartNote())
+            mPendingStarts.insert(event);
+        else
+            mPendingUpdates.insert(event);
+
+        return true;
+    }
+
+    void updateHighWaterMark(int numQueued) noexcept
+    {
+        int highWaterMark = mHighWaterMark.load();
+
+        while (numQueued > highWaterMark && ! mHighWaterMark.compare_exchange_weak(highWaterMark, numQueued))
+        {
+        }
+    }
+
+    void updateBlockStartTime(double now)
+    {
+        // The audio callback is itself a little jittery, so the block clock counts samples
+        // and is only nudged towards the system clock, unless it has drifted too far
+        const double maxClockErrorMs = jmax(20.0, 4.0 * mSchedulingLatencyMs.load());
+        const double error = now - mBlockStartTime;
+
+        if (mBlockStartTime <= 0.0 || std::abs(error) > maxClockErrorMs)
+            mBlockStartTime = now;
+        else
+            mBlockStartTime += error * clockCorrectionRate;
+    }
+
+    static constexpr double clockCorrectionRate = 0.01;
+
+    // Marks an update that has been replaced by a later one
+    static constexpr int mergedUpdateID = -2;
+
+    /** A fixed size ring of events in time order, so the oldest can be dropped without
+        moving the others.
+    */
+    class PendingEventList
+    {
+    public:
+        void reset(int capacity)
+        {
+            mEvents.assign((size_t)capacity, SoundEvent());
+            mFirst = 0;
+            mSize = 0;
+        }
+
+        int size() const noexcept                       { return mSize; }
+        bool isEmpty() const noexcept                   { return mSize == 0; }
+        const SoundEvent& front() const noexcept        { return mEvents[(size_t)mFirst]; }
+
+        void popFront() noexcept
+        {
+            jassert(mSize > 0);
+            mFirst = (mFirst + 1) % (int)mEvents.size();
+            --mSize;
+        }
+
+        // Events nearly always arrive in time order, so this searches from the end. Events
+        // with the same time keep the order they were sent in.
+        void insert(const SoundEvent& event) noexcept
+        {
+            jassert(mSize < (int)mEvents.size());
+            int position = mSize;
+
+            while (position > 0 && at(position - 1).time > event.time)
+            {
+                at(position) = at(position - 1);
+                --position;
+            }
+
+            at(position) = event;
+            ++mSize;
+        }
+
+    private:
+        SoundEvent& at(int index) noexcept              { return mEvents[(size_t)((mFirst + index) % (int)mEvents.size())]; }
+
+        std::vector<SoundEvent> mEvents;
+        int                     mFirst = 0;
+        int                     mSize = 0;
+    };
+
+    EventRing               mRings[maxNumProducers];
+    int                     mCapacity = 0;
+    int                     mStartReserve = 0;
+
+    std::atomic<double> mSchedulingLatencyMs { 0.0 };
+    std::atomic<bool>   mInterpolateMergedUpdates { true };
+    std::atomic<uint32> mNumMergedUpdates { 0 };
+
+    std::atomic<int>    mHighWaterMark { 0 };
+    std::atomic<uint32> mNumDroppedUpdates { 0 };
+    std::atomic<uint32> mNumDroppedStarts { 0 };
+
+    // Audio thread only
+    double              mSampleRate = 0.0;
+    double              mBlockStartTime = 0.0;
+    int                 mFirstRingToRead = 0;
+
+    // These are allocated up front and never grow past the capacity, so they don't allocate.
+    // Starts and updates wait in separate lists so the oldest update can be dropped in O(1)
+    PendingEventList        mPendingStarts;
+    PendingEventList        mPendingUpdates;
+    std::vector<SoundEvent> mBlockEvents;
+
+    // The index in mBlockEvents of the last update for each note in the block
+    NoteIDMap<int>      mBlockUpdateIndices;
+
 };
@@ -36,6 +36,33 @@ SpatialSamplerSound::SpatialSamplerSound(const String& soundName,
     }
 }
 
+SpatialSamplerSound::SpatialSamplerSound(const String& soundName,
+                            ClipSampleCache::Ptr cache,
+                            int cacheIndex,
+                            int note,
+                            double attackTimeSecs,
+                            double releaseTimeSecs)
+    : mName(soundName),
+      mSampleCache(cache),
+      mSourceSampleRate(cache->getEntry(cacheIndex).sampleRate),
+      mNoteID(note)
+{
+    const int numSamples = cache->getEntry(cacheIndex).numSamples;
+
+    if (auto* samples = cache->getSamples(cacheIndex))
+    {
+        // The cached data already has the padding used for interpolation
+        mLength = numSamples - 4;
+
+        // Refer to the mapped data rather than copying it, it is never written to
+        float* channels[] = { const_cast<float*>(samples) };
+        mSampleData.reset(new AudioBuffer<float>(channels, 1, numSamples));
+
+        mAdsrParams.attack  = static_cast<float>(attackTimeSecs);
+        mAdsrParams.release = static_cast<float>(releaseTimeSecs);
+    }
+}
+
 SpatialSamplerSound::~SpatialSamplerSound()
 {
 }
@@ -65,6 +92,13 @@ void SpatialSamplerVoice::startNote(int noteID, float velocity, const glm::vec3&
         mAdsr.setSampleRate (sound->mSourceSampleRate);
         mAdsr.setParameters (sound->mAdsrParams);
 
+        mSourceSampleRate = sound->mSourceSampleRate;
+        mSourceLength = sound->mLength;
+        mSustainLevel = sound->mAdsrParams.sustain;
+        mReleaseTime = sound->mAdsrParams.release;
+        mEnvelopeLevel = 0.0f;
+        mIsReleasing = false;
+
         mAdsr.noteOn();
     }
     else
@@ -78,6 +112,7 @@ void SpatialSamplerVoice::stopNote(float /*velocity*/, bool allowTailOff)
     if (allowTailOff)
     {
         mAdsr.noteOff();
+        mIsReleasing = true;
     }
     else
     {
@@ -96,45 +131,72 @@ void SpatialSamplerVoice::renderNextBlock(AudioBuffer<float>& outputBuffer, int
         // Get sample data
         auto& data = *playingSound->mSampleData;
         const float* const monoSamples = data.getReadPointer(0);
-            
-        const int numChannels = outputBuffer.getNumChannels();
-        const float invSamples = 1.0f / (float)numSamples;
         
         // Calculate increments to smoothly interpolate channel amplitudes
-        for (int i = 0; i < mChannelAmplitudes.size(); ++i)
-            mChannelAmplitudeIncrements[i] = (mChannelAmplitudeTargets[i] - mChannelAmplitudes[i]) * invSamples;
+        prepareAmplitudeRamps(numSamples);
         
-        int i = 0;
+        float* const mono = getMonoScratchBuffer();
+        float envelope = mEnvelopeLevel;
         
-        while (--numSamples >= 0)
+        while (numSamples > 0)
         {
-            auto pos = (int)mSourceSamplePosition;
-            auto alpha = (float)(mSourceSamplePosition - pos);
-            auto invAlpha = 1.0f - alpha;
+            const int numThisTime = jmin(numSamples, getScratchBlockSize());
+            bool finished = false;
+            int i = 0;
             
-            for (int i = 0; i < mChannelAmplitudes.size(); ++i)
-                mChannelAmplitudes[i] += mChannelAmplitudeIncrements[i];
-
-            // just using a very simple linear interpolation here..
-            float s = (monoSamples[pos] * invAlpha + monoSamples[pos + 1] * alpha);
-
-            auto envelopeValue = mAdsr.getNextSample();
-            
-            for (int ch = 0; ch < numChannels; ++ch)
+            // Render the enveloped source once, then mix it into every speaker
+            while (i < numThisTime)
             {
-                float* out = outputBuffer.getWritePointer(ch, startSample);
-            
-                out[i] += s * envelopeValue * mChannelAmplitudes[ch];
+                auto pos = (int)mSourceSamplePosition;
+                auto alpha = (float)(mSourceSamplePosition - pos);
+                auto invAlpha = 1.0f - alpha;
+                
+                // just using a very simple linear interpolation here..
+                const float s = (monoSamples[pos] * invAlpha + monoSamples[pos + 1] * alpha);
+                
+                envelope = mAdsr.getNextSample();
+                mono[i++] = s * envelope;
+                
+                mSourceSamplePosition += mPitchRatio;
+                
+                if (mSourceSamplePosition > playingSound->mLength || ! mAdsr.isActive())
+                {
+                    finished = true;
+                    break;
+                }
             }
-        
-            mSourceSamplePosition += mPitchRatio;
-            i++;
             
-            if (mSourceSamplePosition > playingSound->mLength)
+            addMonoToSpeakerChannels(mono, outputBuffer, startSample, i);
+            
+            if (finished)
             {
                 stopNote(0.0f, false);
                 break;
             }
+            
+            startSample += numThisTime;
+            numSamples -= numThisTime;
         }
+        
+        mEnvelopeLevel = envelope;
     }
 }
+
+float SpatialSamplerVoice::getAudibility() const noexcept
+{
+    if (! isVoiceActive())
+        return 0.0f;
+    
+    // The ADSR doesn't expose its stage, so until the release a note is assumed to be
+    // heading for its sustain level. This stops freshly started notes looking quiet.
+    const float level = mIsReleasing ? mEnvelopeLevel : jmax(mEnvelopeLevel, mSustainLevel);
+    
+    double secondsLeft = (mSourceLength - mSourceSamplePosition) / jmax(1.0, mSourceSampleRate * mPitchRatio);
+    
+    if (mIsReleasing)
+        secondsLeft = jmin(secondsLeft, (double)(mEnvelopeLevel * mReleaseTime));
+    
+    const float remaining = (float)jlimit(0.0, 1.0, secondsLeft / audibilityHorizonSeconds);
+    
+    return SpatialSynthVoice::getAudibility() * level * remaining;
+}
@@ -3,13 +3,14 @@
 
 #include <JuceHeader.h>
 #include "SpatialSynth.h"
+#include "ClipSampleCache.h"
 
 //==============================================================================
 /**
     A subclass of SpatialSynthSound that represents a sampled audio clip.
 
     This is a pretty basic sampler, and just attempts to load the whole audio stream
-    into memory.
+    into memory, or plays it straight from a memory mapped ClipSampleCache.
 
     To use it, create a SpatialSynth, add some SpatialSamplerVoice objects to it, then
     give it some SampledSound objects to play.
@@ -27,17 +28,29 @@ public:
                   double releaseTimeSecs,
                   double maxSampleLengthSeconds);
 
+    /** Plays one of the clips in a memory mapped cache without copying it. */
+    SpatialSamplerSound(const String& name,
+                  ClipSampleCache::Ptr cache,
+                  int cacheIndex,
+                  int noteID,
+                  double attackTimeSecs,
+                  double releaseTimeSecs);
+
     ~SpatialSamplerSound() override;
 
     //==============================================================================
     
     const String&       getName() const noexcept                  { return mName; }
     AudioBuffer<float>* getAudioData() const noexcept       { return mSampleData.get(); }
+    double              getSourceSampleRate() const noexcept      { return mSourceSampleRate; }
 
     //==============================================================================
 
     void setEnvelopeParameters(ADSR::Parameters parametersToUse)    { mAdsrParams = parametersToUse; }
 
+    /** Changes the note that plays this sound. Only call this before giving the sound to a synth. */
+    void setNoteID(int note)                                        { mNoteID = note; }
+
     //==============================================================================
     bool appliesToNote(int note) override { return note == mNoteID; };
 
@@ -47,6 +60,7 @@ private:
 
     String                              mName;
     std::unique_ptr<AudioBuffer<float>> mSampleData;
+    ClipSampleCache::Ptr                mSampleCache;
     double                              mSourceSampleRate;
     
     int                                 mLength = 0;
@@ -85,12 +99,24 @@ public:
     void renderNextBlock(AudioBuffer<float>&, int startSample, int numSamples) override;
     using SpatialSynthVoice::renderNextBlock;
 
+    /** Scales the DBAP gains by the envelope, and fades out voices that are about to end. */
+    float getAudibility() const noexcept override;
+
 private:
     //==============================================================================
     double mPitchRatio = 0;
     double mSourceSamplePosition = 0;
+    double mSourceSampleRate = 44100.0;
+    int    mSourceLength = 0;
 
     ADSR   mAdsr;
+    float  mEnvelopeLevel = 0.0f;
+    float  mSustainLevel = 1.0f;
+    float  mReleaseTime = 0.0f;
+    bool   mIsReleasing = false;
+
+    // Voices with less than this long left to play count as proportionally quieter
+    static constexpr double audibilityHorizonSeconds = 0.5;
 
     JUCE_LEAK_DETECTOR (SpatialSamplerVoice)
 };
@@ -1,143 +1,788 @@
-
 #include "SpatialSynth.h"
 
 
 //==============================================================================
 SpatialSynth::SpatialSynth()
 {
-    
+    mAppliedSpeakerPositions.reserve (SpatialSynthVoice::maxNumSpeakerOutputs);
+    mMovedSpeakers.reserve (SpatialSynthVoice::maxNumSpeakerOutputs);
+
+    // Periodically free anything the audio thread has swapped out
+    startTimer (500);
 }
 
 SpatialSynth::~SpatialSynth()
 {
+    stopTimer();
+    ++mGainGridGeneration; // Stops any grid that's being built
+    delete mDrainingVoiceSet;
 }
 
 //==============================================================================
-SpatialSynthVoice* SpatialSynth::getVoice (const int index) const
+void SpatialSynth::VoiceSet::initialise()
+{
+    // Make sure nothing here can need to allocate on the audio thread
+    activeVoices.reserve ((size_t)voices.size());
+    freeVoices.reserve ((size_t)voices.size());
+    noteVoiceMap.prepare (voices.size());
+
+    for (auto* voice : voices)
+    {
+        jassert (! voice->isVoiceActive());
+        freeVoices.push_back (voice);
+    }
+}
+
+void SpatialSynth::setSounds (const ReferenceCountedArray<SpatialSynthSound>& newSounds)
 {
-    const ScopedLock sl (mLock);
-    return mVoices [index];
+    mMessageThreadSounds = newSounds;
+
+    auto newSet = std::make_unique<SoundSet>();
+    newSet->sounds = newSounds;
+    mSoundSet.publish (std::move (newSet));
 }
 
-void SpatialSynth::clearVoices()
+void SpatialSynth::setNoteStealingEnabled (const bool shouldSteal)
 {
-    const ScopedLock sl (mLock);
-    mVoices.clear();
+    mShouldStealNotes = shouldSteal;
 }
 
-SpatialSynthVoice* SpatialSynth::addVoice (SpatialSynthVoice* const newVoice)
+void SpatialSynth::setMinimumRenderingSubdivisionSize (int numSamples, bool shouldBeStrict) noexcept
 {
-    const ScopedLock sl (mLock);
-    newVoice->setCurrentPlaybackSampleRate (mSampleRate);
-    newVoice->setNumSpeakerOutputs((int)mSpeakerPositions.size());
-    return mVoices.add (newVoice);
+    jassert (numSamples > 0); // it wouldn't make much sense for this to be less than 1
+    mMinimumSubBlockSize = numSamples;
+    mSubBlockSubdivisionIsStrict = shouldBeStrict;
 }
 
-void SpatialSynth::removeVoice (const int index)
+//==============================================================================
+void SpatialSynth::setSampleRate(const double newRate)
 {
-    const ScopedLock sl (mLock);
-    mVoices.remove (index);
+    mPendingSampleRate = newRate;
 }
 
-void SpatialSynth::clearSounds()
+void SpatialSynth::updateSpeakerPositions(const std::vector<glm::vec3> &positions)
 {
-    const ScopedLock sl (mLock);
-    mSounds.clear();
+    jassert (positions.size() <= (size_t)SpatialSynthVoice::maxNumSpeakerOutputs);
+
+    mSpeakerPositions = positions;
+
+    // The exact gains are used until the new grid is ready
+    mGainGrid.reset();
+    buildVBAPPanner();
+    publishSpeakerLayout();
+    buildGainGrid();
 }
 
-SpatialSynthSound* SpatialSynth::addSound (const SpatialSynthSound::Ptr& newSound)
+void SpatialSynth::setDBAPGridResolution (int resolution)
 {
-    const ScopedLock sl (mLock);
-    return mSounds.add (newSound);
+    resolution = resolution > 0 ? jlimit (DBAPGainGrid::minResolution, DBAPGainGrid::maxResolution, resolution) : 0;
+
+    if (resolution == mDBAPGridResolution)
+        return;
+
+    mDBAPGridResolution = resolution;
+
+    // A grid with the old resolution is still correct, so it's used until the new one is ready
+    if (resolution == 0)
+    {
+        mGainGrid.reset();
+        publishSpeakerLayout();
+    }
+
+    buildGainGrid();
 }
 
-void SpatialSynth::removeSound (const int index)
+void SpatialSynth::setDBAPCulling (float minGainDb, int maxSpeakers)
 {
-    const ScopedLock sl (mLock);
-    mSounds.remove (index);
+    const float minGain = Decibels::decibelsToGain (minGainDb);
+    maxSpeakers = jmax (0, maxSpeakers);
+
+    if (minGain == mDBAPCullMinGain && maxSpeakers == mDBAPCullMaxSpeakers)
+        return;
+
+    mDBAPCullMinGain = minGain;
+    mDBAPCullMaxSpeakers = maxSpeakers;
+
+    publishSpeakerLayout();
 }
 
-void SpatialSynth::setNoteStealingEnabled (const bool shouldSteal)
+void SpatialSynth::setPanningMode (PanningMode mode, int ambisonicOrder)
 {
-    mShouldStealNotes = shouldSteal;
+    ambisonicOrder = jlimit (AmbisonicPanner::minOrder, AmbisonicPanner::maxOrder, ambisonicOrder);
+
+    if (mode == mPanningMode && (mode != PanningMode::ambisonics || ambisonicOrder == mAmbisonicOrder))
+        return;
+
+    mPanningMode = mode;
+    mAmbisonicOrder = ambisonicOrder;
+
+    buildVBAPPanner();
+    publishSpeakerLayout();
+    publishRenderPool();
 }
 
-void SpatialSynth::setMinimumRenderingSubdivisionSize (int numSamples, bool shouldBeStrict) noexcept
+void SpatialSynth::buildVBAPPanner()
 {
-    jassert (numSamples > 0); // it wouldn't make much sense for this to be less than 1
-    mMinimumSubBlockSize = numSamples;
-    mSubBlockSubdivisionIsStrict = shouldBeStrict;
+    if (mPanningMode != PanningMode::vbap || mSpeakerPositions.empty())
+    {
+        mVBAPPanner.reset();
+        return;
+    }
+
+    const double startTime = Time::getMillisecondCounterHiRes();
+    mVBAPPanner = VBAPPanner::build (mSpeakerPositions);
+
+    if (mVBAPPanner == nullptr)
+        return;
+
+    String message;
+    message << "VBAP " << (mVBAPPanner->is2D() ? "pairs" : "triangles") << " for " << (int)mSpeakerPositions.size()
+            << " speakers: " << mVBAPPanner->getNumSpeakerSets() << " built in "
+            << String (Time::getMillisecondCounterHiRes() - startTime, 1) << "ms";
+    Logger::getCurrentLogger()->writeToLog (message);
+}
+
+void SpatialSynth::publishSpeakerLayout()
+{
+    auto newLayout = std::make_unique<SpeakerLayout>();
+    newLayout->positions = mSpeakerPositions;
+    newLayout->gainGrid = mGainGrid;
+    newLayout->dbapSolver.setSpeakerPositions (mSpeakerPositions);
+    newLayout->cullMinGain = mDBAPCullMinGain;
+    newLayout->cullMaxSpeakers = mDBAPCullMaxSpeakers;
+
+    newLayout->panningMode = mPanningMode;
+
+    // Without a VBAP panner (a single speaker, say) the voices fall back to DBAP
+    if (mPanningMode == PanningMode::vbap)
+        newLayout->vbap = mVBAPPanner;
+
+    if (mPanningMode == PanningMode::ambisonics && ! mSpeakerPositions.empty())
+        newLayout->ambisonics.reset (new AmbisonicPanner (mSpeakerPositions, mAmbisonicOrder,
+                                                          mRenderBufferBlockSize > 0 ? mRenderBufferBlockSize : defaultAmbisonicBusSize));
+
+    mSpeakerLayout.publish (std::move (newLayout));
+}
+
+void SpatialSynth::buildGainGrid()
+{
+    const int generation = ++mGainGridGeneration;
+    mGainGridBuilder.removeAllJobs (false, 0);
+
+    if (mDBAPGridResolution == 0 || mSpeakerPositions.empty())
+        return;
+
+    auto positions = mSpeakerPositions;
+    const int resolution = mDBAPGridResolution;
+
+    mGainGridBuilder.addJob ([this, positions, resolution, generation]
+    {
+        auto grid = DBAPGainGrid::build (positions, resolution, [this, generation]
+        {
+            return mGainGridGeneration.load() != generation;
+        });
+
+        if (grid == nullptr)
+            return;
+
+        const ScopedLock sl (mBuiltGainGridLock);
+        mBuiltGainGrid = std::move (grid);
+        mBuiltGainGridGeneration = generation;
+    });
+}
+
+void SpatialSynth::publishBuiltGainGrid()
+{
+    std::unique_ptr<DBAPGainGrid> grid;
+    int generation = 0;
+
+    {
+        const ScopedLock sl (mBuiltGainGridLock);
+        grid = std::move (mBuiltGainGrid);
+        generation = mBuiltGainGridGeneration;
+    }
+
+    if (grid != nullptr && generation == mGainGridGeneration.load())
+    {
+        mGainGrid = std::move (grid);
+        publishSpeakerLayout();
+    }
+}
+
+void SpatialSynth::setNumRenderThreads (int numThreads)
+{
+    numThreads = jmax (0, numThreads);
+
+    if (numThreads == mNumRenderThreads)
+        return;
+
+    mNumRenderThreads = numThreads;
+    publishRenderPool();
+}
+
+void SpatialSynth::prepareRenderBuffers (int numOutputChannels, int maximumBlockSize)
+{
+    if (numOutputChannels == mRenderBufferChannels && maximumBlockSize == mRenderBufferBlockSize)
+        return;
+
+    const bool blockSizeChanged = maximumBlockSize != mRenderBufferBlockSize;
+
+    mRenderBufferChannels = numOutputChannels;
+    mRenderBufferBlockSize = maximumBlockSize;
+    publishRenderPool();
+
+    // Resizes the Ambisonic bus
+    if (blockSizeChanged && mPanningMode == PanningMode::ambisonics)
+        publishSpeakerLayout();
+}
+
+void SpatialSynth::publishRenderPool()
+{
+    // The worker threads are started here and stopped when the old pool is
+    // released, so the audio thread only ever swaps a pointer
+    auto newPool = std::make_unique<VoiceRenderPool> (mNumRenderThreads);
+
+    // With Ambisonics the voices are rendered into the bus rather than the output
+    const int numChannels = mPanningMode == PanningMode::ambisonics ? AmbisonicPanner::getNumChannels (mAmbisonicOrder)
+                                                : mRenderBufferChannels;
+
+    if (mNumRenderThreads > 0)
+        newPool->prepare (numChannels, mRenderBufferBlockSize);
+    mRenderPool.publish (std::move (newPool));
+}
+
+void SpatialSynth::allNotesOff (const bool allowTailOff)
+{
+    Command c;
+    c.type = allowTailOff ? Command::allNotesOffWithTailOff : Command::allNotesOff;
+
+    const bool wasQueued = mCommands.push (c);
+    jassert (wasQueued); // the audio thread isn't keeping up (or isn't running)
+    ignoreUnused (wasQueued);
+}
+
+void SpatialSynth::timerCallback()
+{
+    mVoiceSet.releaseRetiredObjects();
+    mSpeakerLayout.releaseRetiredObjects();
+    mRenderPool.releaseRetiredObjects();
+
+    while (auto retiredSet = mSoundSet.takeRetiredObject())
+        mRetiredSoundSets.push_back (std::move (retiredSet));
+
+    releaseUnusedSoundSets();
+    updateVoiceStealRate();
+    publishBuiltGainGrid();
+}
+
+void SpatialSynth::updateVoiceStealRate()
+{
+    const uint32 numStolen = mNumStolenVoices.load();
+    const double now = Time::getMillisecondCounterHiRes();
+
+    if (mLastStealCountTime > 0.0 && now > mLastStealCountTime)
+        mVoiceStealsPerSecond = (float)((numStolen - mLastNumStolenVoices) * 1000.0 / (now - mLastStealCountTime));
+
+    mLastNumStolenVoices = numStolen;
+    mLastStealCountTime = now;
+}
+
+void SpatialSynth::releaseUnusedSoundSets()
+{
+    // A voice drops its sound on the audio thread when the note ends, so an old sound
+    // is only released here once that set holds the last reference to it. Sounds that
+    // are still in use by the current set are safe to let go of straight away.
+    for (auto& soundSet : mRetiredSoundSets)
+    {
+        auto& sounds = soundSet->sounds;
+
+        for (int i = sounds.size(); --i >= 0;)
+        {
+            auto* sound = sounds.getObjectPointerUnchecked (i);
+
+            if (sound->getReferenceCount() == 1 || mMessageThreadSounds.contains (sound))
+                sounds.remove (i);
+        }
+    }
+
+    mRetiredSoundSets.erase (std::remove_if (mRetiredSoundSets.begin(), mRetiredSoundSets.end(),
+                                             [] (const std::unique_ptr<SoundSet>& s) { return s->sounds.isEmpty(); }),
+                             mRetiredSoundSets.end());
 }
 
 //==============================================================================
-void SpatialSynth::setSampleRate(const double newRate)
+void SpatialSynth::handleMessageThreadChanges()
 {
-    if (mSampleRate != newRate)
+    const double newRate = mPendingSampleRate.load();
+
+    if (newRate != mSampleRate && newRate > 0.0)
     {
-        const ScopedLock sl (mLock);
-        allNotesOff (false);
+        stopAllVoices (false);
         mSampleRate = newRate;
 
-        for (auto* voice : mVoices)
-            voice->setCurrentPlaybackSampleRate(newRate);
+        if (auto* voiceSet = mVoiceSet.get())
+            for (auto* voice : voiceSet->voices)
+                voice->setCurrentPlaybackSampleRate (newRate);
+
+        releaseDrainingVoices();
+    }
+
+    Command c;
+
+    while (mCommands.pop (c))
+    {
+        switch (c.type)
+        {
+            case Command::allNotesOff:              stopAllVoices (false); break;
+            case Command::allNotesOffWithTailOff:   stopAllVoices (true);  break;
+            default:                                jassertfalse; break;
+        }
+    }
+
+    mRenderPool.update();
+    mSoundSet.update();
+
+    if (mSpeakerLayout.update())
+    {
+        const auto panningMode = mSpeakerLayout->panningMode;
+        const bool panningModeChanged = panningMode != mAppliedPanningMode;
+        mAppliedPanningMode = panningMode;
+
+        findMovedSpeakers();
+
+        for (auto* set : { mVoiceSet.get(), mDrainingVoiceSet })
+        {
+            if (set != nullptr)
+            {
+                applySpeakerLayout (*set, panningModeChanged);
+                applySpeakerMoves (*set);
+            }
+        }
+    }
+
+    // Make sure there's room to hand back a set that's still draining before swapping
+    if (! mVoiceSet.canRetire())
+        return;
+
+    VoiceSet* replacedSet = nullptr;
+
+    if (mVoiceSet.update (replacedSet))
+    {
+        // Only the most recent old set is left to play out, any older one is cut off.
+        // The replaced set is released at the end of the block once it falls silent.
+        releaseDrainingVoices();
+        jassert (mDrainingVoiceSet == nullptr);
+
+        mDrainingVoiceSet = replacedSet;
+
+        prepareVoiceSet (*mVoiceSet.get());
     }
 }
 
-void SpatialSynth::updateSpeakerPositions(const std::vector<glm::vec3> &positions)
+void SpatialSynth::prepareVoiceSet (VoiceSet& voiceSet)
 {
-    const ScopedLock sl (mLock);
-    
-    mSpeakerPositions = positions;
-    
-    for (auto* voice : mVoices)
-        voice->setNumSpeakerOutputs((int)positions.size());
+    for (auto* voice : voiceSet.voices)
+        voice->setCurrentPlaybackSampleRate (mSampleRate);
+
+    applySpeakerLayout (voiceSet);
 }
 
+void SpatialSynth::releaseDrainingVoices()
+{
+    if (mDrainingVoiceSet != nullptr && mVoiceSet.retire (mDrainingVoiceSet))
+        mDrainingVoiceSet = nullptr;
+}
+
+void SpatialSynth::applySpeakerLayout (VoiceSet& voiceSet, bool panningModeChanged)
+{
+    const auto* layout = mSpeakerLayout.get();
+    int numOutputs = 0;
+
+    // With Ambisonics a voice's channels are the channels of the bus
+    if (layout != nullptr)
+        numOutputs = layout->ambisonics != nullptr ? layout->ambisonics->getNumChannels()
+                                                   : (int)layout->positions.size();
+
+    for (auto* voice : voiceSet.voices)
+    {
+        // Switching between panning modes changes what every gain means
+        if (panningModeChanged || (int)voice->mChannelAmplitudeTargets.size() != numOutputs)
+            voice->mNeedsDBAPUpdate = true;
+
+        voice->setNumSpeakerOutputs (numOutputs);
+
+        if (layout != nullptr)
+            voice->setDBAPCulling (layout->cullMinGain, layout->cullMaxSpeakers);
+    }
+}
+
+void SpatialSynth::findMovedSpeakers()
+{
+    const auto& positions = mSpeakerLayout->positions;
+    mMovedSpeakers.clear();
+
+    // Speakers that were added or removed change every voice's channels anyway
+    if (positions.size() == mAppliedSpeakerPositions.size())
+        for (size_t i = 0; i < positions.size(); ++i)
+            if (positions[i] != mAppliedSpeakerPositions[i])
+                mMovedSpeakers.push_back ((int)i);
+
+    // Both are reserved for every speaker, so this doesn't allocate
+    mAppliedSpeakerPositions.assign (positions.begin(), positions.end());
+}
+
+void SpatialSynth::applySpeakerMoves (VoiceSet& voiceSet)
+{
+    if (mMovedSpeakers.empty())
+        return;
+
+    const auto* layout = mSpeakerLayout.get();
+    const bool isDBAP = layout->vbap == nullptr && layout->ambisonics == nullptr;
+
+    for (auto* voice : voiceSet.voices)
+    {
+        if (isDBAP && voice->mIsInActiveList && ! voice->getNeedsDBAPUpdate())
+        {
+            voice->updateDBAPForMovedSpeakers (layout->positions, mMovedSpeakers);
+        }
+        else
+        {
+            // Voices that are idle or about to be updated anyway only need to forget their distances
+            voice->mInverseDistancesValid = false;
+
+            // The VBAP triangles and the Ambisonic centre can change with any speaker
+            if (voice->mIsInActiveList)
+                voice->mNeedsDBAPUpdate = true;
+        }
+    }
+}
+
+//==============================================================================
+void SpatialSynth::activateVoice (VoiceSet& voiceSet, SpatialSynthVoice* voice)
+{
+    if (voice->mIsInActiveList)
+        return;
+
+    auto& freeVoices = voiceSet.freeVoices;
+
+    // Free voices are normally taken from the end of the list, so search backwards
+    for (int i = (int)freeVoices.size(); --i >= 0;)
+    {
+        if (freeVoices[(size_t)i] == voice)
+        {
+            freeVoices[(size_t)i] = freeVoices.back();
+            freeVoices.pop_back();
+            break;
+        }
+    }
+
+    voice->mIsInActiveList = true;
+    voiceSet.activeVoices.push_back (voice);
+}
+
+void SpatialSynth::unmapVoice (VoiceSet& voiceSet, SpatialSynthVoice* voice)
+{
+    const int noteID = voice->mMappedNoteID;
+
+    if (noteID < 0)
+        return;
+
+    if (auto* mapped = voiceSet.noteVoiceMap.find (noteID))
+    {
+        if (*mapped == voice)
+        {
+            if (voice->mNextVoiceForNote != nullptr)
+                voiceSet.noteVoiceMap.insert (noteID, voice->mNextVoiceForNote);
+            else
+                voiceSet.noteVoiceMap.remove (noteID);
+        }
+        else
+        {
+            // A retriggered note has been remapped to a newer voice, so unlink this one
+            // from the chain behind it
+            for (auto* previous = *mapped; previous != nullptr; previous = previous->mNextVoiceForNote)
+            {
+                if (previous->mNextVoiceForNote == voice)
+                {
+                    previous->mNextVoiceForNote = voice->mNextVoiceForNote;
+                    break;
+                }
+            }
+        }
+    }
+
+    voice->mMappedNoteID = -1;
+    voice->mNextVoiceForNote = nullptr;
+}
+
+SpatialSynthVoice* SpatialSynth::findVoiceForNote (int noteID) const noexcept
+{
+    for (auto* voiceSet : { mVoiceSet.get(), mDrainingVoiceSet })
+        if (voiceSet != nullptr)
+            if (auto* mapped = voiceSet->noteVoiceMap.find (noteID))
+                for (auto* voice = *mapped; voice != nullptr; voice = voice->mNextVoiceForNote)
+                    if (voice->getCurrentNoteID() == noteID)
+                        return voice;
+
+    return nullptr;
+}
+
+void SpatialSynth::retireFinishedVoices()
+{
+    if (auto* voiceSet = mVoiceSet.get())
+        retireFinishedVoices (*voiceSet);
+}
+
+void SpatialSynth::retireFinishedVoices (VoiceSet& voiceSet)
+{
+    auto& activeVoices = voiceSet.activeVoices;
+
+    for (int i = (int)activeVoices.size(); --i >= 0;)
+    {
+        auto* voice = activeVoices[(size_t)i];
+
+        if (! voice->isVoiceActive())
+        {
+            activeVoices[(size_t)i] = activeVoices.back();
+            activeVoices.pop_back();
+
+            voice->mIsInActiveList = false;
+            unmapVoice (voiceSet, voice);
+            voiceSet.freeVoices.push_back (voice);
+        }
+    }
+}
+
+//==============================================================================
 template <typename floatType>
 void SpatialSynth::processNextBlock (AudioBuffer<floatType>& outputAudio,
+                                    const std::vector<SoundEvent>& events,
                                     int startSample,
                                     int numSamples)
 {
+    handleMessageThreadChanges();
+
     // must set the sample rate before using this!
     jassert (mSampleRate != 0);
-    const int targetChannels = outputAudio.getNumChannels();
-    
-    const ScopedLock sl (mLock);
-    
-    for (auto* voice : mVoices)
-        if (voice->getNeedsDBAPUpdate())
-            voice->updateDBAPAmplitudes(mSpeakerPositions);
-    
-    if (targetChannels > 0)
+
+    if (mVoiceSet.get() == nullptr || mSpeakerLayout.get() == nullptr)
+        return;
+
+    // Render the voices between each event, as long as the gaps aren't too small
+    int eventIndex = 0;
+    int blockOffset = 0;
+    bool firstEvent = true;
+
+    while (numSamples > 0)
+    {
+        if (eventIndex >= (int)events.size())
+        {
+            renderSubBlock (outputAudio, startSample, numSamples);
+            break;
+        }
+
+        const auto& event = events[(size_t)eventIndex];
+        jassert (eventIndex == 0 || event.sampleOffset >= events[(size_t)eventIndex - 1].sampleOffset);
+
+        const int samplesToNextEvent = event.sampleOffset - blockOffset;
+
+        if (samplesToNextEvent >= numSamples)
+        {
+            renderSubBlock (outputAudio, startSample, numSamples);
+            break;
+        }
+
+        if (samplesToNextEvent < ((firstEvent && ! mSubBlockSubdivisionIsStrict) ? 1 : mMinimumSubBlockSize))
+        {
+            handleSoundEvent (event);
+            ++eventIndex;
+            continue;
+        }
+
+        firstEvent = false;
+        renderSubBlock (outputAudio, startSample, samplesToNextEvent);
+
+        startSample += samplesToNextEvent;
+        numSamples  -= samplesToNextEvent;
+        blockOffset += samplesToNextEvent;
+    }
+
+    // Any events beyond the end of the block are started now rather than dropped
+    while (eventIndex < (int)events.size())
+        handleSoundEvent (events[(size_t)eventIndex++]);
+
+    retireFinishedVoices();
+
+    if (mDrainingVoiceSet != nullptr)
+    {
+        retireFinishedVoices (*mDrainingVoiceSet);
+
+        if (mDrainingVoiceSet->activeVoices.empty())
+            releaseDrainingVoices();
+    }
+}
+
+template <typename floatType>
+void SpatialSynth::renderSubBlock (AudioBuffer<floatType>& outputAudio,
+                                   int startSample,
+                                   int numSamples)
+{
+    updateDBAPAmplitudes();
+
+    if (outputAudio.getNumChannels() == 0)
+        return;
+
+    if (auto* panner = mSpeakerLayout->ambisonics.get())
+        renderAmbisonics (*panner, outputAudio, startSample, numSamples);
+    else
         renderVoices (outputAudio, startSample, numSamples);
 }
 
+template <typename floatType>
+void SpatialSynth::renderAmbisonics (AmbisonicPanner& panner,
+                                     AudioBuffer<floatType>& outputAudio,
+                                     int startSample,
+                                     int numSamples)
+{
+    auto& bus = panner.getBus();
+
+    while (numSamples > 0)
+    {
+        const int numThisTime = jmin (numSamples, bus.getNumSamples());
+
+        bus.clear (0, numThisTime);
+        renderVoices (bus, 0, numThisTime);
+        panner.decode (numThisTime, outputAudio, startSample);
+
+        startSample += numThisTime;
+        numSamples -= numThisTime;
+    }
+}
+
+void SpatialSynth::updateDBAPAmplitudes()
+{
+    if (auto* panner = mSpeakerLayout->ambisonics.get())
+    {
+        for (auto* set : { mVoiceSet.get(), mDrainingVoiceSet })
+            if (set != nullptr)
+                for (auto* voice : set->activeVoices)
+                    if (voice->getNeedsDBAPUpdate())
+                        voice->updateAmbisonicAmplitudes (*panner);
+
+        return;
+    }
+
+    if (auto* vbap = mSpeakerLayout->vbap.get())
+    {
+        for (auto* set : { mVoiceSet.get(), mDrainingVoiceSet })
+            if (set != nullptr)
+                for (auto* voice : set->activeVoices)
+                    if (voice->getNeedsDBAPUpdate())
+                        voice->updateVBAPAmplitudes (*vbap);
+
+        return;
+    }
+
+    const auto* gainGrid = mSpeakerLayout->gainGrid.get();
+    const int numSpeakers = mSpeakerLayout->dbapSolver.getNumSpeakers();
+
+    for (auto* set : { mVoiceSet.get(), mDrainingVoiceSet })
+    {
+        if (set == nullptr)
+            continue;
+
+        for (auto* voice : set->activeVoices)
+        {
+            if (! voice->getNeedsDBAPUpdate())
+                continue;
+
+            // The batch solver writes straight into the voice's targets
+            if ((int)voice->mChannelAmplitudeTargets.size() != numSpeakers)
+                voice->updateDBAPAmplitudes (mSpeakerLayout->positions, gainGrid);
+            else if (gainGrid != nullptr && gainGrid->getGains (voice->mPosition, voice->mChannelAmplitudeTargets.data(), numSpeakers))
+                voice->dbapTargetsChanged();
+            else
+                addToDBAPBatch (voice);
+        }
+    }
+
+    flushDBAPBatch();
+}
+
+void SpatialSynth::addToDBAPBatch (SpatialSynthVoice* voice)
+{
+    if (mDBAPBatchSize == DBAPBatchSolver::maxBatchSize)
+        flushDBAPBatch();
+
+    mDBAPBatchVoices[(size_t)mDBAPBatchSize] = voice;
+    mDBAPBatchPositions[(size_t)mDBAPBatchSize] = voice->mPosition;
+    mDBAPBatchGains[(size_t)mDBAPBatchSize] = voice->mChannelAmplitudeTargets.data();
+    ++mDBAPBatchSize;
+}
+
+void SpatialSynth::flushDBAPBatch()
+{
+    if (mDBAPBatchSize == 0)
+        return;
+
+    mSpeakerLayout->dbapSolver.calculateGains (mDBAPBatchPositions.data(), mDBAPBatchGains.data(), mDBAPBatchSize);
+
+    for (int i = 0; i < mDBAPBatchSize; ++i)
+        mDBAPBatchVoices[(size_t)i]->dbapTargetsChanged();
+
+    mDBAPBatchSize = 0;
+}
+
+void SpatialSynth::handleSoundEvent (const SoundEvent& event)
+{
+    if (event.isStartNote())
+        noteOn (event.noteID, event.soundID, 1.0f, event.position);
+    else
+        handlePositionChange (event.noteID, event.position);
+}
+
 // explicit template instantiation
-template void SpatialSynth::processNextBlock<float>  (AudioBuffer<float>&,  int, int);
-template void SpatialSynth::processNextBlock<double> (AudioBuffer<double>&, int, int);
+template void SpatialSynth::processNextBlock<float>  (AudioBuffer<float>&,  const std::vector<SoundEvent>&, int, int);
+template void SpatialSynth::processNextBlock<double> (AudioBuffer<double>&, const std::vector<SoundEvent>&, int, int);
 
-void SpatialSynth::renderNextBlock (AudioBuffer<float>& outputAudio,
+void SpatialSynth::renderNextBlock (AudioBuffer<float>& outputAudio, const std::vector<SoundEvent>& events,
                                    int startSample, int numSamples)
 {
-    processNextBlock (outputAudio, startSample, numSamples);
+    processNextBlock (outputAudio, events, startSample, numSamples);
 }
 
-void SpatialSynth::renderNextBlock (AudioBuffer<double>& outputAudio,
+void SpatialSynth::renderNextBlock (AudioBuffer<double>& outputAudio, const std::vector<SoundEvent>& events,
                                    int startSample, int numSamples)
 {
-    processNextBlock (outputAudio, startSample, numSamples);
+    processNextBlock (outputAudio, events, startSample, numSamples);
 }
 
 void SpatialSynth::renderVoices (AudioBuffer<float>& buffer, int startSample, int numSamples)
 {
-    for (auto* voice : mVoices)
+    // The voices left over from the previous sounds are only tailing off, so they're
+    // rendered here before the current voices, whichever way those are rendered
+    if (mDrainingVoiceSet != nullptr)
+        for (auto* voice : mDrainingVoiceSet->activeVoices)
+            voice->renderNextBlock (buffer, startSample, numSamples);
+
+    const auto& activeVoices = mVoiceSet->activeVoices;
+
+    if (auto* pool = mRenderPool.get())
+        if (pool->getNumWorkerThreads() > 0
+             && (int)activeVoices.size() >= minVoicesPerRenderThread * (pool->getNumWorkerThreads() + 1)
+             && pool->render (activeVoices, buffer, startSample, numSamples))
+            return;
+
+    for (auto* voice : activeVoices)
         voice->renderNextBlock (buffer, startSample, numSamples);
 }
 
 void SpatialSynth::renderVoices (AudioBuffer<double>& buffer, int startSample, int numSamples)
 {
-    for (auto* voice : mVoices)
-        voice->renderNextBlock (buffer, startSample, numSamples);
+    for (auto* set : { mVoiceSet.get(), mDrainingVoiceSet })
+        if (set != nullptr)
+            for (auto* voice : set->activeVoices)
+                voice->renderNextBlock (buffer, startSample, numSamples);
 }
 
 //==============================================================================
@@ -146,19 +791,29 @@ void SpatialSynth::noteOn (const int noteID,
                            const float velocity,
                            const glm::vec3& pos)
 {
-    const ScopedLock sl (mLock);
+    auto* voiceSet = mVoiceSet.get();
+    auto* soundSet = mSoundSet.get();
+
+    if (voiceSet == nullptr || soundSet == nullptr)
+        return;
+
+    auto* sound = soundSet->sounds.getObjectPointer (soundID);
+
+    // If hitting a note that's still ringing, stop it first. Anonymous
+    // notes (negative IDs) can't be addressed again so are left to play out.
+    if (auto* voice = findVoiceForNote (noteID))
+        stopVoice (voice, 1.0f, true);
 
-    auto* sound = mSounds[soundID].get();
-    
-    // If hitting a note that's still ringing, stop it first (it could be
-    // still playing because of the sustain or sostenuto pedal).
-    for (auto* voice : mVoices)
-        if (voice->getCurrentNoteID() == noteID)
-            stopVoice (voice, 1.0f, true);
+    if (voiceSet->freeVoices.empty())
+        retireFinishedVoices();
 
     // TODO: remove midi references from these stealing functions
-    startVoice (findFreeVoice (sound, soundID, mShouldStealNotes),
-                sound, noteID, velocity, pos);
+    auto* voice = findFreeVoice (sound, soundID, mShouldStealNotes.load());
+
+    if (voice != nullptr && sound != nullptr && voice->isVoiceActive())
+        ++mNumStolenVoices;
+
+    startVoice (voice, sound, noteID, velocity, pos);
 
 }
 
@@ -170,9 +825,23 @@ void SpatialSynth::startVoice (SpatialSynthVoice* const voice,
 {
     if (voice != nullptr && sound != nullptr)
     {
+        auto& voiceSet = *mVoiceSet.get();
+
         if (voice->mCurrentlyPlayingSound != nullptr)
             voice->stopNote (0.0f, false);
 
+        activateVoice (voiceSet, voice);
+        unmapVoice (voiceSet, voice);
+
+        if (noteID >= 0)
+        {
+            if (auto* mapped = voiceSet.noteVoiceMap.find (noteID))
+                voice->mNextVoiceForNote = *mapped;
+
+            voiceSet.noteVoiceMap.insert (noteID, voice);
+            voice->mMappedNoteID = noteID;
+        }
+
         voice->mNoteOnTime = ++mLastNoteOnCounter;
         voice->mCurrentlyPlayingSound = sound;
 
@@ -194,35 +863,28 @@ void SpatialSynth::noteOff (const int noteID,
                             const float velocity,
                             const bool allowTailOff)
 {
-    const ScopedLock sl (mLock);
-
-    for (auto* voice : mVoices)
-    {
-        if (voice->getCurrentNoteID() == noteID)
-        {
-            if (auto sound = voice->getCurrentlyPlayingSound())
-            {
-                stopVoice(voice, velocity, allowTailOff);
-            }
-        }
-    }
+    if (auto* voice = findVoiceForNote (noteID))
+        if (voice->getCurrentlyPlayingSound() != nullptr)
+            stopVoice (voice, velocity, allowTailOff);
 }
 
-void SpatialSynth::allNotesOff (const bool allowTailOff)
+void SpatialSynth::stopAllVoices (const bool allowTailOff)
 {
-    const ScopedLock sl (mLock);
-
-    for (auto* voice : mVoices)
-        voice->stopNote (1.0f, allowTailOff);
+    for (auto* voiceSet : { mVoiceSet.get(), mDrainingVoiceSet })
+        if (voiceSet != nullptr)
+            for (auto* voice : voiceSet->activeVoices)
+                voice->stopNote (1.0f, allowTailOff);
 }
 
 void SpatialSynth::handlePositionChange (int noteID, glm::vec3 newPosition)
 {
-    const ScopedLock sl (mLock);
-
-    for (auto* voice : mVoices)
-        if (voice->getCurrentNoteID() == noteID)
-            voice->positionChanged(newPosition);
+    // The tail of a retriggered note keeps moving with the voice that replaced it
+    for (auto* voiceSet : { mVoiceSet.get(), mDrainingVoiceSet })
+        if (voiceSet != nullptr)
+            if (auto* mapped = voiceSet->noteVoiceMap.find (noteID))
+                for (auto* voice = *mapped; voice != nullptr; voice = voice->mNextVoiceForNote)
+                    if (voice->getCurrentNoteID() == noteID)
+                        voice->positionChanged(newPosition);
 }
 
 
@@ -231,11 +893,15 @@ SpatialSynthVoice* SpatialSynth::findFreeVoice (SpatialSynthSound* soundToPlay,
                                                 int midiNoteNumber,
                                                 const bool stealIfNoneAvailable) const
 {
-    const ScopedLock sl (mLock);
+    const auto& freeVoices = mVoiceSet->freeVoices;
+
+    for (int i = (int)freeVoices.size(); --i >= 0;)
+    {
+        auto* voice = freeVoices[(size_t)i];
 
-    for (auto* voice : mVoices)
         if ((! voice->isVoiceActive()) && voice->canPlaySound (soundToPlay))
             return voice;
+    }
 
     if (stealIfNoneAvailable)
         return findVoiceToSteal (soundToPlay, midiNoteNumber);
@@ -246,44 +912,36 @@ SpatialSynthVoice* SpatialSynth::findFreeVoice (SpatialSynthSound* soundToPlay,
 SpatialSynthVoice* SpatialSynth::findVoiceToSteal (SpatialSynthSound* soundToPlay,
                                                    int midiNoteNumber) const
 {
-    // This voice-stealing algorithm applies the following heuristics:
-    // - Re-use the oldest notes first
-    // - Protect the lowest & topmost notes, even if sustained, but not if they've been released.
+    // Steal the voice that will be missed least: the quietest one, or the oldest of
+    // the quietest if there's a tie. This is a single pass so it stays cheap with a
+    // large pool of voices.
+    ignoreUnused (midiNoteNumber);
+
+    const auto& activeVoices = mVoiceSet->activeVoices;
 
     // apparently you are trying to render audio without having any voices...
-    jassert (! mVoices.isEmpty());
+    jassert (! activeVoices.empty());
 
-    // this is a list of voices we can steal, sorted by how long they've been running
-    Array<SpatialSynthVoice*> usableVoices;
-    usableVoices.ensureStorageAllocated (mVoices.size());
+    SpatialSynthVoice* quietestVoice = nullptr;
+    float quietestAudibility = 0.0f;
 
-    for (auto* voice : mVoices)
+    for (auto* voice : activeVoices)
     {
-        if (voice->canPlaySound (soundToPlay))
-        {
-            jassert (voice->isVoiceActive()); // We wouldn't be here otherwise
+        if (! voice->canPlaySound (soundToPlay))
+            continue;
 
-            usableVoices.add (voice);
+        jassert (voice->isVoiceActive()); // We wouldn't be here otherwise
 
-            // NB: Using a functor rather than a lambda here due to scare-stories about
-            // compilers generating code containing heap allocations..
-            struct Sorter
-            {
-                bool operator() (const SpatialSynthVoice* a, const SpatialSynthVoice* b) const noexcept { return a->wasStartedBefore (*b); }
-            };
+        const float audibility = voice->getAudibility();
 
-            std::sort (usableVoices.begin(), usableVoices.end(), Sorter());
+        if (quietestVoice == nullptr
+             || audibility < quietestAudibility
+             || (audibility == quietestAudibility && voice->wasStartedBefore (*quietestVoice)))
+        {
+            quietestVoice = voice;
+            quietestAudibility = audibility;
         }
     }
 
-    // The oldest note that's playing with the target sound is ideal..
-    for (auto* voice : usableVoices)
-        if (voice->getCurrentlyPlayingSound() == soundToPlay)
-            return voice;
-
-    // TODO: add heuristic to preserve sounds with most playtime left?..
-
-    jassert(usableVoices.size() >= 0);
-
-    return usableVoices[0];
+    return quietestVoice;
 }
@@ -4,6 +4,14 @@
 
 #include "SpatialSynthSound.h"
 #include "SpatialSynthVoice.h"
+#include "SoundEventData.h"
+#include "NoteIDMap.h"
+#include "VoiceRenderPool.h"
+#include "RealtimeSnapshot.h"
+#include "DBAPGainGrid.h"
+#include "DBAPBatchSolver.h"
+#include "AmbisonicPanner.h"
+#include "VBAPPanner.h"
 
 /** These classes are based on the Juce Synth classes
     but replace the midi functionality for arbitrary 
@@ -18,14 +26,19 @@
     to describe each sound available to your synth, and a subclass of SpatialSynthVoice
     which can play back one of these sounds.
 
-    Then you can use the addVoice() and addSound() methods to give the synthesiser a
-    set of sounds, and a set of voices it can use to play them. If you only give it
+    Then you can use the setSounds() and setVoicePool() methods to give the synthesiser a
+    set of sounds, and a pool of voices it can use to play them. If you only give it
     one voice it will be monophonic - the more voices it has, the more polyphony it'll
-    have available.
+    have available. The number of voices is independent of the number of sounds.
 
-    Then repeatedly call the renderNextBlock() method to produce the audio. Any midi
-    events that go in will be scanned for note on/off messages, and these are used to
-    start and stop the voices playing the appropriate sounds.
+    The audio thread never waits on a lock. Everything the message thread changes is
+    either sent as a small command through a lock-free queue, or built as a complete
+    new snapshot (sounds, voice pool, speaker layout) that the audio thread swaps in at
+    the start of its next block. Replaced snapshots are deleted on the message thread.
+
+    Then repeatedly call the renderNextBlock() method to produce the audio. Any sound
+    events that go in are used to start voices and move them, at the sample within the
+    block that each event is scheduled for.
 
     While it's playing, you can also cause notes to be triggered by calling the noteOn(),
     noteOff() and other controller methods.
@@ -36,7 +49,7 @@
 
     @tags{Audio}
 */
-class SpatialSynth
+class SpatialSynth  : private Timer
 {
 public:
     //==============================================================================
@@ -49,47 +62,46 @@ public:
     virtual ~SpatialSynth();
 
     //==============================================================================
-    /** Deletes all voices. */
-    void clearVoices();
+    /** Replaces the voices with a pool of numVoices new ones.  (Message thread only)
 
-    /** Returns the number of voices that have been added. */
-    int getNumVoices() const noexcept                               { return mVoices.size(); }
+        The voices are allocated in one contiguous block, and the pool is swapped in at
+        the start of the next block. Notes already playing on the old pool are left to
+        play out, after which it is deleted on the message thread, so this can be used
+        to change the polyphony while playing.
+    */
+    template <typename VoiceType>
+    void setVoicePool (int numVoices)
+    {
+        jassert (numVoices > 0);
 
-    /** Returns one of the voices that have been added. */
-    SpatialSynthVoice* getVoice (int index) const;
+        mNumVoices = numVoices;
+        mVoiceSet.publish (std::make_unique<VoicePool<VoiceType>> (numVoices));
+    }
 
-    /** Adds a new voice to the synth.
+    /** Returns the number of voices in the most recent pool passed to setVoicePool(). */
+    int getNumVoices() const noexcept                               { return mNumVoices; }
 
-        All the voices should be the same class of object and are treated equally.
+    //==============================================================================
+    /** Replaces all the sounds.  (Message thread only)
 
-        The object passed in will be managed by the synthesiser, which will delete
-        it later on when no longer needed. The caller should not retain a pointer to the
-        voice.
+        Notes that are still playing the old sounds carry on until they finish. The old
+        sounds are only deleted once no voices are using them, and always on the
+        message thread.
     */
-    SpatialSynthVoice* addVoice (SpatialSynthVoice* newVoice);
-
-    /** Deletes one of the voices. */
-    void removeVoice (int index);
-
-    //==============================================================================
-    /** Deletes all sounds. */
-    void clearSounds();
+    void setSounds (const ReferenceCountedArray<SpatialSynthSound>& newSounds);
 
-    /** Returns the number of sounds that have been added to the synth. */
-    int getNumSounds() const noexcept                               { return mSounds.size(); }
+    /** Returns the number of sounds in the most recent set passed to setSounds(). */
+    int getNumSounds() const noexcept                               { return mMessageThreadSounds.size(); }
 
-    /** Returns one of the sounds. */
-    SpatialSynthSound::Ptr getSound (int index) const noexcept       { return mSounds[index]; }
+    /** Returns one of the sounds passed to setSounds(). */
+    SpatialSynthSound::Ptr getSound (int index) const noexcept       { return mMessageThreadSounds[index]; }
 
-    /** Adds a new sound to the synthesiser.
+    /** Picks up anything that has been changed on the message thread.  (Audio thread only)
 
-        The object passed in is reference counted, so will be deleted when the
-        synthesiser and all voices are no longer using it.
+        This is called at the start of renderNextBlock(), but can be called before any
+        notes are triggered for the block so that they see the latest sounds.
     */
-    SpatialSynthSound* addSound (const SpatialSynthSound::Ptr& newSound);
-
-    /** Removes and deletes one of the sounds. */
-    void removeSound (int index);
+    void handleMessageThreadChanges();
 
     //==============================================================================
     /** If set to true, then the synth will try to take over an existing voice if
@@ -103,7 +115,15 @@ public:
     /** Returns true if note-stealing is enabled.
         @see setNoteStealingEnabled
     */
-    bool isNoteStealingEnabled() const noexcept                     { return mShouldStealNotes; }
+    bool isNoteStealingEnabled() const noexcept                     { return mShouldStealNotes.load(); }
+
+    /** Returns the total number of notes that have taken over a playing voice. */
+    uint32 getNumStolenVoices() const noexcept                      { return mNumStolenVoices.load(); }
+
+    /** Returns how many voices were stolen per second, measured every half second.
+        (Message thread only)
+    */
+    float getVoiceStealsPerSecond() const noexcept                  { return mVoiceStealsPerSecond; }
 
     //==============================================================================
     /** Triggers a note-on event.
@@ -130,12 +150,14 @@ public:
                           float velocity,
                           bool allowTailOff);
 
-    /** This will turn off any voices that are playing a sound.
+    /** This will turn off any voices that are playing a sound.  (Message thread only)
+
+        The request is queued and carried out at the start of the next block.
 
         If allowTailOff is true, the voices will be allowed to fade out the notes gracefully
         (if they can do). If this is false, the notes will all be cut off immediately.
     */
-    virtual void allNotesOff(bool allowTailOff);
+    void allNotesOff (bool allowTailOff);
 
     /** Handles the moving of audio sources and causes DBAP update.
     */
@@ -146,15 +168,66 @@ public:
     //==============================================================================
     /** Tells the synthesiser what the sample rate is for the audio it's being used to render.
 
-        This value is propagated to the voices so that they can use it to render the correct
-        pitches.
+        This value is propagated to the voices at the start of the next block so that
+        they can use it to render the correct pitches.
     */
-    virtual void setSampleRate (double sampleRate);
+    void setSampleRate (double sampleRate);
 
-    /** Updates the positions of the speakers to allow DBAP spatialisation
+    /** Updates the positions of the speakers to allow DBAP spatialisation.  (Message thread only)
      */
     void updateSpeakerPositions(const std::vector<glm::vec3>& positions);
 
+    /** Sets the number of points along each axis of a grid of precomputed DBAP gains,
+        or 0 to always calculate the gains exactly (the default).  (Message thread only)
+
+        The grid is rebuilt on a background thread whenever the speakers move, and the
+        exact gains are used until it is ready.
+        @see DBAPGainGrid
+    */
+    void setDBAPGridResolution (int resolution);
+
+    /** Leaves speakers quieter than minGainDb out of each voice's mix, and if maxSpeakers
+        is above 0 mixes each voice into at most that many speakers.  (Message thread only)
+        @see SpatialSynthVoice::setDBAPCulling
+    */
+    void setDBAPCulling (float minGainDb, int maxSpeakers);
+
+    /** The ways the voices can be spread over the speakers. */
+    enum class PanningMode
+    {
+        dbap,           /**< Distance based amplitude panning over every speaker (the default). */
+        vbap,           /**< Vector base amplitude panning between the two or three nearest speakers. */
+        ambisonics      /**< An Ambisonic bus that is decoded to the speakers once per block. */
+    };
+
+    /** Sets how the voices are panned. The ambisonicOrder is only used by the
+        Ambisonics mode.  (Message thread only)
+        @see VBAPPanner, AmbisonicPanner
+    */
+    void setPanningMode (PanningMode mode, int ambisonicOrder);
+
+    /** Returns the mode passed to setPanningMode(). */
+    PanningMode getPanningMode() const noexcept                 { return mPanningMode; }
+
+    //==============================================================================
+    /** Sets the number of extra threads used to render voices in parallel.  (Message thread only)
+
+        With 0 (the default) every voice is rendered on the audio thread. Otherwise
+        the voices are split between the audio thread and this many realtime worker
+        threads, each mixing into its own buffer. The output is deterministic but can
+        differ from the serial mode in the last bit because of the summing order.
+    */
+    void setNumRenderThreads (int numThreads);
+
+    /** Returns the number of worker threads used for rendering. */
+    int getNumRenderThreads() const noexcept                    { return mNumRenderThreads; }
+
+    /** Tells the synth the number of output channels and the largest block size that
+        will be rendered, so that buffers for parallel rendering can be preallocated.
+        Blocks that don't fit are rendered serially.
+    */
+    void prepareRenderBuffers (int numOutputChannels, int maximumBlockSize);
+
     /** Creates the next block of audio output.
 
         This will process the next numSamples of data from all the voices, and add that output
@@ -162,16 +235,18 @@ public:
         data will be added to the current contents of the buffer, so you should clear it
         before calling this method if necessary.
 
-        The midi events in the inputMidi buffer are parsed for note and controller events,
-        and these are used to trigger the voices. Note that the startSample offset applies
-        both to the audio output buffer and the midi input buffer, so any midi events
-        with timestamps outside the specified region will be ignored.
+        The events are used to start notes and move them, and must be in order of their
+        sampleOffset. The block is rendered in sub-blocks split at each event, so the
+        events land on the sample they were scheduled for. Note that the startSample
+        offset applies both to the audio output buffer and the event offsets.
     */
     void renderNextBlock (AudioBuffer<float>& outputAudio,
+                          const std::vector<SoundEvent>& events,
                           int startSample,
                           int numSamples);
 
     void renderNextBlock (AudioBuffer<double>& outputAudio,
+                          const std::vector<SoundEvent>& events,
                           int startSample,
                           int numSamples);
 
@@ -183,32 +258,123 @@ public:
     /** Sets a minimum limit on the size to which audio sub-blocks will be divided when rendering.
 
         When rendering, the audio blocks that are passed into renderNextBlock() will be split up
-        into smaller blocks that lie between all the incoming midi messages, and it is these smaller
+        into smaller blocks that lie between all the incoming events, and it is these smaller
         sub-blocks that are rendered with multiple calls to renderVoices().
 
-        Obviously in a pathological case where there are midi messages on every sample, then
+        Obviously in a pathological case where there are events on every sample, then
         renderVoices() could be called once per sample and lead to poor performance, so this
         setting allows you to set a lower limit on the block size.
 
-        The default setting is 32, which means that midi messages are accurate to about < 1ms
+        The default setting is 32, which means that events are accurate to about < 1ms
         accuracy, which is probably fine for most purposes, but you may want to increase or
         decrease this value for your synth.
 
         If shouldBeStrict is true, the audio sub-blocks will strictly never be smaller than numSamples.
 
         If shouldBeStrict is false (default), the first audio sub-block in the buffer is allowed
-        to be smaller, to make sure that the first MIDI event in a buffer will always be sample-accurate
+        to be smaller, to make sure that the first event in a buffer will always be sample-accurate
         (this can sometimes help to avoid quantisation or phasing issues).
     */
     void setMinimumRenderingSubdivisionSize (int numSamples, bool shouldBeStrict = false) noexcept;
 
 protected:
     //==============================================================================
-    /** This is used to control access to the rendering callback and the note trigger methods. */
-    CriticalSection                          mLock;
-
-    OwnedArray<SpatialSynthVoice>            mVoices;
-    ReferenceCountedArray<SpatialSynthSound> mSounds;
+    /** A set of voices along with the bookkeeping the audio thread uses to manage them.
+        It is built and preallocated on the message thread and then owned by the
+        audio thread once it has been swapped in.
+    */
+    struct VoiceSet
+    {
+        virtual ~VoiceSet() = default;
+
+        /** Puts all the voices on the free list and allocates the bookkeeping. */
+        void initialise();
+
+        /** Points to every voice in the set. The voices themselves are owned by the subclass. */
+        Array<SpatialSynthVoice*>       voices;
+
+        /** The voices that are currently playing (or tailing off), in no particular order.
+            Rendering and note lookups only visit these, so their cost scales with the
+            number of playing voices rather than the number of voices in the set.
+
+            These are reserved for every voice in initialise(). They're std::vectors because
+            a juce::Array frees memory as it shrinks, which mustn't happen on the audio thread.
+        */
+        std::vector<SpatialSynthVoice*> activeVoices;
+
+        /** The voices that are idle and can be started straight away. */
+        std::vector<SpatialSynthVoice*> freeVoices;
+
+        /** Maps each addressable noteID to the most recent voice started with it. A note
+            that was retriggered while its last voice was still tailing off has the older
+            voices chained on behind it, newest first.
+        */
+        NoteIDMap<SpatialSynthVoice*>   noteVoiceMap;
+    };
+
+    struct SpeakerLayout
+    {
+        std::vector<glm::vec3>          positions;
+
+        // Shared by the layouts with the same speakers. Layouts are always deleted on
+        // the message thread, so the last reference is never dropped on the audio thread
+        std::shared_ptr<const DBAPGainGrid> gainGrid;
+        float                           cullMinGain = 0.0f;
+        int                             cullMaxSpeakers = 0;
+
+        // Only used by the audio thread
+        DBAPBatchSolver                 dbapSolver;
+
+        // Set when panning with VBAP, and shared like the gain grid
+        std::shared_ptr<const VBAPPanner> vbap;
+
+        // Set when panning with Ambisonics, the voices then render into its bus. Only used
+        // by the audio thread
+        std::unique_ptr<AmbisonicPanner> ambisonics;
+
+        PanningMode                     panningMode = PanningMode::dbap;
+    };
+
+    /** A VoiceSet that owns its voices as one contiguous array. */
+    template <typename VoiceType>
+    struct VoicePool  : public VoiceSet
+    {
+        explicit VoicePool (int numVoices)
+            : storage (new VoiceType[(size_t)numVoices])
+        {
+            voices.ensureStorageAllocated (numVoices);
+
+            for (int i = 0; i < numVoices; ++i)
+                voices.add (&storage[(size_t)i]);
+
+            initialise();
+        }
+
+        std::unique_ptr<VoiceType[]>    storage;
+    };
+
+    struct SoundSet
+    {
+        ReferenceCountedArray<SpatialSynthSound> sounds;
+    };
+
+    RealtimeSnapshot<VoiceSet>          mVoiceSet;
+    RealtimeSnapshot<SoundSet>          mSoundSet;
+    RealtimeSnapshot<SpeakerLayout>     mSpeakerLayout;
+    RealtimeSnapshot<VoiceRenderPool>   mRenderPool;
+
+    /** Moves any voices that have stopped playing from the active list back onto the free list. */
+    void retireFinishedVoices();
+    void retireFinishedVoices (VoiceSet&);
+
+    /** Stops all the playing voices.  (Audio thread only) */
+    virtual void stopAllVoices (bool allowTailOff);
+
+    /** Returns the most recently started voice currently playing the given noteID, or
+        nullptr. Notes still playing out on a replaced set of voices are found too.
+        Anonymous notes (negative IDs) are never found.
+    */
+    SpatialSynthVoice* findVoiceForNote (int noteID) const noexcept;
 
     /** Renders the voices for the given range.
         By default this just calls renderNextBlock() on each voice, but you may need
@@ -232,9 +398,10 @@ protected:
                                               bool stealIfNoneAvailable) const;
 
     /** Chooses a voice that is most suitable for being re-used.
-        The default method will attempt to find the oldest voice that isn't the
-        bottom or top note being played. If that's not suitable for your synth,
-        you can override this method and do something more cunning instead.
+        The default method picks the voice with the lowest getAudibility(), and the
+        oldest of those if several are equally quiet, in a single pass over the
+        active voices. If that's not suitable for your synth, you can override this
+        method and do something more cunning instead.
     */
     virtual SpatialSynthVoice* findVoiceToSteal (SpatialSynthSound* soundToPlay,
                                                  int midiNoteNumber) const;
@@ -259,15 +426,116 @@ protected:
 
 private:
     //==============================================================================
+    /** Small changes sent from the message thread to the audio thread. */
+    struct Command
+    {
+        enum Type
+        {
+            allNotesOff,
+            allNotesOffWithTailOff
+        };
+
+        Type type = allNotesOff;
+    };
+
+    LockFreeFifo<Command>   mCommands { 64 };
+
     double                  mSampleRate = 0;
-    std::vector<glm::vec3>  mSpeakerPositions;
+    std::atomic<double>     mPendingSampleRate { 0.0 };
+    std::atomic<bool>       mShouldStealNotes { true };
     uint32                  mLastNoteOnCounter = 0;
+    std::atomic<uint32>     mNumStolenVoices { 0 };
     int                     mMinimumSubBlockSize = 32;
     bool                    mSubBlockSubdivisionIsStrict = false;
-    bool                    mShouldStealNotes = true;
+
+    // Message thread copies of what has been published
+    ReferenceCountedArray<SpatialSynthSound> mMessageThreadSounds;
+    int                     mNumVoices = 0;
+    int                     mNumRenderThreads = 0;
+    int                     mRenderBufferChannels = 0;
+    int                     mRenderBufferBlockSize = 0;
+
+    // Below this many playing voices the thread handoff costs more than it saves
+    static constexpr int    minVoicesPerRenderThread = 4;
+
+    // The previous set of voices, kept until its playing notes have finished
+    VoiceSet*               mDrainingVoiceSet = nullptr;
+
+    uint32                  mLastNumStolenVoices = 0;
+    double                  mLastStealCountTime = 0.0;
+    float                   mVoiceStealsPerSecond = 0.0f;
+
+    // Replaced sound sets wait here until none of their sounds are still playing
+    std::vector<std::unique_ptr<SoundSet>> mRetiredSoundSets;
+
+    std::vector<glm::vec3>  mSpeakerPositions;
+    std::shared_ptr<const DBAPGainGrid> mGainGrid;
+    int                     mDBAPGridResolution = 0;
+    float                   mDBAPCullMinGain = 0.0f;
+    int                     mDBAPCullMaxSpeakers = 0;
+    PanningMode             mPanningMode = PanningMode::dbap;
+    int                     mAmbisonicOrder = 3;
+    std::shared_ptr<const VBAPPanner> mVBAPPanner;
+
+    // The mode of the layout the voices' gains were last set for.  (Audio thread only)
+    PanningMode             mAppliedPanningMode = PanningMode::dbap;
+
+    // The speakers of the last layout the audio thread picked up, and which of them
+    // moved in the one after. Reserved for every speaker.  (Audio thread only)
+    std::vector<glm::vec3>  mAppliedSpeakerPositions;
+    std::vector<int>        mMovedSpeakers;
+
+    // The bus size used before prepareRenderBuffers() is called. Longer blocks are
+    // rendered through the bus in chunks
+    static constexpr int    defaultAmbisonicBusSize = 512;
+
+    // Each grid build is tagged with the layout it was started for, so that
+    // one that finishes after the speakers have moved again is thrown away
+    std::atomic<int>        mGainGridGeneration { 0 };
+    CriticalSection         mBuiltGainGridLock;
+    std::unique_ptr<DBAPGainGrid> mBuiltGainGrid;
+    int                     mBuiltGainGridGeneration = 0;
+
+    // Voices whose DBAP gains are waiting to be calculated in one batch.  (Audio thread only)
+    std::array<SpatialSynthVoice*, DBAPBatchSolver::maxBatchSize>  mDBAPBatchVoices;
+    std::array<glm::vec3, DBAPBatchSolver::maxBatchSize>           mDBAPBatchPositions;
+    std::array<float*, DBAPBatchSolver::maxBatchSize>              mDBAPBatchGains;
+    int                     mDBAPBatchSize = 0;
+
+    // Declared after everything its jobs use, so it's stopped first
+    ThreadPool              mGainGridBuilder { 1 };
+
+    void prepareVoiceSet (VoiceSet&);
+    void releaseUnusedSoundSets();
+    void updateVoiceStealRate();
+    void releaseDrainingVoices();
+    void applySpeakerLayout (VoiceSet&, bool panningModeChanged = false);
+    void findMovedSpeakers();
+    void applySpeakerMoves (VoiceSet&);
+    void publishRenderPool();
+    void publishSpeakerLayout();
+    void buildGainGrid();
+    void buildVBAPPanner();
+    void publishBuiltGainGrid();
+    void updateDBAPAmplitudes();
+    void addToDBAPBatch (SpatialSynthVoice*);
+    void flushDBAPBatch();
+
+    void activateVoice (VoiceSet&, SpatialSynthVoice*);
+    void unmapVoice (VoiceSet&, SpatialSynthVoice*);
+
+    void timerCallback() override;
 
     template <typename floatType>
-    void processNextBlock (AudioBuffer<floatType>&, int startSample, int numSamples);
+    void processNextBlock (AudioBuffer<floatType>&, const std::vector<SoundEvent>&, int startSample, int numSamples);
+
+    template <typename floatType>
+    void renderSubBlock (AudioBuffer<floatType>&, int startSample, int numSamples);
+
+    template <typename floatType>
+    void renderAmbisonics (AmbisonicPanner&, AudioBuffer<floatType>&, int startSample, int numSamples);
+
+    void handleSoundEvent (const SoundEvent&);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpatialSynth)
 };
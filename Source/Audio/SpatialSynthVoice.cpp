@@ -9,10 +9,25 @@
 */
 
 #include "SpatialSynthVoice.h"
+#include "DBAPGainGrid.h"
+#include "AmbisonicPanner.h"
+#include "VBAPPanner.h"
 #include "geometric.hpp"
 
+// The DBAP distance exponent for a 6dB rolloff per doubling of distance
+static const float dbapDistanceExponent = 0.5f * std::log(std::pow(10.0f, (6.0f / 20.0f))) / std::log(2.0f);
+
+
+SpatialSynthVoice::SpatialSynthVoice()
+{
+    mChannelAmplitudes.reserve(maxNumSpeakerOutputs);
+    mChannelAmplitudeTargets.reserve(maxNumSpeakerOutputs);
+    mChannelAmplitudeIncrements.reserve(maxNumSpeakerOutputs);
+    mActiveChannels.reserve(maxNumSpeakerOutputs);
+    mCullScratch.reserve(maxNumSpeakerOutputs);
+    mInverseDistances.reserve(maxNumSpeakerOutputs);
+}
 
-SpatialSynthVoice::SpatialSynthVoice() {}
 SpatialSynthVoice::~SpatialSynthVoice() {}
 
 void SpatialSynthVoice::setCurrentPlaybackSampleRate(double newRate)
@@ -22,14 +37,35 @@ void SpatialSynthVoice::setCurrentPlaybackSampleRate(double newRate)
 
 void SpatialSynthVoice::setNumSpeakerOutputs (int numSpeakers)
 {
-    mChannelAmplitudes.resize(numSpeakers, 1.0f);
-    mChannelAmplitudeTargets.resize(numSpeakers, 1.0f);
-    mChannelAmplitudeIncrements.resize(numSpeakers, 1.0f);
+    jassert (numSpeakers <= maxNumSpeakerOutputs);
+    numSpeakers = jmin (numSpeakers, maxNumSpeakerOutputs);
+
+    if (numSpeakers != (int)mChannelAmplitudes.size())
+        mInverseDistancesValid = false;
+
+    mChannelAmplitudes.resize(numSpeakers, 0.0f);
+    mChannelAmplitudeTargets.resize(numSpeakers, 0.0f);
+    mChannelAmplitudeIncrements.resize(numSpeakers, 0.0f);
+    mInverseDistances.resize(numSpeakers, 0.0f);
+    updateActiveChannels();
+}
+
+void SpatialSynthVoice::setDBAPCulling (float minGain, int maxSpeakers) noexcept
+{
+    minGain = jmax (0.0f, minGain);
+    maxSpeakers = jlimit (0, maxNumSpeakerOutputs, maxSpeakers);
+
+    if (minGain == mCullMinGain && maxSpeakers == mCullMaxSpeakers)
+        return;
+
+    mCullMinGain = minGain;
+    mCullMaxSpeakers = maxSpeakers;
+    mNeedsDBAPUpdate = true;
 }
 
 bool SpatialSynthVoice::isVoiceActive() const
 {
-    return getCurrentNoteID() >= 0;
+    return mCurrentlyPlayingSound != nullptr;
 }
 
 void SpatialSynthVoice::clearCurrentNote()
@@ -61,26 +97,105 @@ void SpatialSynthVoice::positionChanged (const glm::vec3& newPosition)
     mNeedsDBAPUpdate = true;
 }
 
-void SpatialSynthVoice::updateDBAPAmplitudes(const std::vector<glm::vec3>& positions)
+void SpatialSynthVoice::prepareAmplitudeRamps (int numSamples)
 {
-    const float rolloffDb = 6.0f;
-    const float rolloffPowFactor = std::log(std::pow(10.0f, (rolloffDb / 20.0f)))/std::log(2.0f);
+    const float invSamples = 1.0f / (float)jmax (1, numSamples);
+
+    for (int n = (int)mActiveChannels.size(); --n >= 0;)
+    {
+        const auto i = (size_t)mActiveChannels[(size_t)n];
+        const float delta = mChannelAmplitudeTargets[i] - mChannelAmplitudes[i];
+
+        // Snap once we are close enough so settled channels skip the ramped pass
+        if (std::abs (delta) < 1.0e-6f)
+        {
+            mChannelAmplitudes[i] = mChannelAmplitudeTargets[i];
+            mChannelAmplitudeIncrements[i] = 0.0f;
+
+            // Channels that have faded out are dropped until a DBAP update adds them again
+            if (mChannelAmplitudes[i] == 0.0f)
+            {
+                mActiveChannels[(size_t)n] = mActiveChannels.back();
+                mActiveChannels.pop_back();
+            }
+        }
+        else
+        {
+            mChannelAmplitudeIncrements[i] = delta * invSamples;
+        }
+    }
+}
+
+void SpatialSynthVoice::addMonoToSpeakerChannels (const float* monoSamples,
+                                                  AudioBuffer<float>& outputBuffer,
+                                                  int startSample,
+                                                  int numSamples)
+{
+    jassert (numSamples <= scratchBlockSize);
+
+    const int numOutputChannels = outputBuffer.getNumChannels();
+
+    // The gain at sample i is a + (i + 1) * inc, which we split into a flat
+    // part (a * s) and a ramped part (n * inc) * (s * (i + 1) / n) so each
+    // channel only needs two vectorised multiply-adds.
+    float* ramped = mScratchBuffer.getWritePointer (1);
+    const float invSamples = 1.0f / (float)numSamples;
+
+    for (int i = 0; i < numSamples; ++i)
+        ramped[i] = monoSamples[i] * (float)(i + 1) * invSamples;
+
+    for (const int ch : mActiveChannels)
+    {
+        if (ch >= numOutputChannels)
+            continue;
+
+        float* out = outputBuffer.getWritePointer (ch, startSample);
+        const float startGain = mChannelAmplitudes[ch];
+        const float gainDelta = mChannelAmplitudeIncrements[ch] * (float)numSamples;
+
+        if (startGain != 0.0f)
+            FloatVectorOperations::addWithMultiply (out, monoSamples, startGain, numSamples);
+
+        if (gainDelta != 0.0f)
+            FloatVectorOperations::addWithMultiply (out, ramped, gainDelta, numSamples);
+
+        mChannelAmplitudes[ch] = startGain + gainDelta;
+    }
+}
+
+void SpatialSynthVoice::calculateDBAPGains (const std::vector<glm::vec3>& speakerPositions,
+                                            const glm::vec3& position,
+                                            float* gains,
+                                            int numSpeakers) noexcept
+{
+    jassert (numSpeakers <= (int)speakerPositions.size());
+
     float k = 0.0f;     // Scaling coeff
     float invk2 = 0.0f; // Inverse square of k
     
-    for (int i = 0; i < mChannelAmplitudeTargets.size(); ++i)
+    for (int i = 0; i < numSpeakers; ++i)
     {
-        const float dist = glm::distance(positions[i], mPosition);
-        const float unNormalized = std::pow(dist, 0.5f * rolloffPowFactor);
-        mChannelAmplitudeTargets[i] = unNormalized;
+        const float dist = glm::distance(speakerPositions[i], position);
+        const float unNormalized = std::pow(dist, dbapDistanceExponent);
+        gains[i] = unNormalized;
         invk2 += 1.0f / (unNormalized * unNormalized);
     }
     
     k = std::sqrt(1.0f / invk2);
     
     // normalize amplitudes
-    for (int i = 0; i < mChannelAmplitudes.size(); ++i)
-        mChannelAmplitudeTargets[i] = std::min(1.0f, k / mChannelAmplitudeTargets[i]);
+    for (int i = 0; i < numSpeakers; ++i)
+        gains[i] = std::min(1.0f, k / gains[i]);
+}
+
+void SpatialSynthVoice::updateDBAPAmplitudes(const std::vector<glm::vec3>& positions,
+                                             const DBAPGainGrid* gainGrid)
+{
+    const int numSpeakers = (int)mChannelAmplitudeTargets.size();
+    float* targets = mChannelAmplitudeTargets.data();
+
+    if (gainGrid == nullptr || ! gainGrid->getGains(mPosition, targets, numSpeakers))
+        calculateDBAPGains(positions, mPosition, targets, numSpeakers);
     
 //    // Distance attenuation test
 //    for (int i = 0; i < mChannelAmplitudes.size(); ++i)
@@ -89,5 +204,165 @@ void SpatialSynthVoice::updateDBAPAmplitudes(const std::vector<glm::vec3>& posit
 //        mChannelAmplitudes[i] = std::min(1.0f, 0.1f / dist);
 //    }
     
+    dbapTargetsChanged();
+}
+
+void SpatialSynthVoice::dbapTargetsChanged() noexcept
+{
+    cullDBAPTargets();
+    updateActiveChannels();
+
+    mGainSum = 0.0f;
+    
+    for (const int ch : mActiveChannels)
+        mGainSum += mChannelAmplitudeTargets[(size_t)ch];
+    
     mNeedsDBAPUpdate = false;
 }
+
+void SpatialSynthVoice::updateAmbisonicAmplitudes (const AmbisonicPanner& panner) noexcept
+{
+    jassert ((int)mChannelAmplitudeTargets.size() == panner.getNumChannels());
+
+    if ((int)mChannelAmplitudeTargets.size() != panner.getNumChannels())
+        return;
+
+    // The harmonics are signed, so these are never culled
+    panner.getEncodingGains (mPosition, mChannelAmplitudeTargets.data());
+    updateActiveChannels();
+
+    // The encoding keeps the level of the source, the omni channel always has a gain of 1
+    mGainSum = 1.0f;
+    mNeedsDBAPUpdate = false;
+}
+
+void SpatialSynthVoice::updateVBAPAmplitudes (const VBAPPanner& panner) noexcept
+{
+    jassert ((int)mChannelAmplitudeTargets.size() == panner.getNumSpeakers());
+
+    if ((int)mChannelAmplitudeTargets.size() != panner.getNumSpeakers())
+        return;
+
+    int speakers[VBAPPanner::maxSpeakersPerSource];
+    float gains[VBAPPanner::maxSpeakersPerSource];
+    const int numGains = panner.getGains (mPosition, mVBAPSetHint, speakers, gains);
+
+    // Every channel with a non-zero target is active, so this clears all the old gains
+    for (const int ch : mActiveChannels)
+        mChannelAmplitudeTargets[(size_t)ch] = 0.0f;
+
+    mGainSum = 0.0f;
+
+    for (int i = 0; i < numGains; ++i)
+    {
+        const int ch = speakers[i];
+        mChannelAmplitudeTargets[(size_t)ch] = gains[i];
+        mGainSum += gains[i];
+
+        if (std::find (mActiveChannels.begin(), mActiveChannels.end(), ch) == mActiveChannels.end())
+            mActiveChannels.push_back (ch);
+    }
+
+    mNeedsDBAPUpdate = false;
+}
+
+void SpatialSynthVoice::updateDBAPForMovedSpeakers (const std::vector<glm::vec3>& positions,
+                                                    const std::vector<int>& movedSpeakers) noexcept
+{
+    const int numSpeakers = (int)mChannelAmplitudeTargets.size();
+
+    if (numSpeakers != (int)positions.size())
+    {
+        mInverseDistancesValid = false;
+        mNeedsDBAPUpdate = true;
+        return;
+    }
+
+    const auto getInverseDistance = [this, &positions] (int i)
+    {
+        return 1.0f / std::pow (glm::distance (positions[(size_t)i], mPosition), dbapDistanceExponent);
+    };
+
+    if (mInverseDistancesValid && mInverseDistancesPosition == mPosition)
+    {
+        for (const int i : movedSpeakers)
+            mInverseDistances[(size_t)i] = getInverseDistance (i);
+    }
+    else
+    {
+        for (int i = 0; i < numSpeakers; ++i)
+            mInverseDistances[(size_t)i] = getInverseDistance (i);
+
+        mInverseDistancesPosition = mPosition;
+        mInverseDistancesValid = true;
+    }
+
+    // Every gain still changes with the normalisation, but that's only a multiply
+    float invk2 = 0.0f;
+
+    for (const float u : mInverseDistances)
+        invk2 += u * u;
+
+    const float k = std::sqrt (1.0f / invk2);
+
+    for (int i = 0; i < numSpeakers; ++i)
+        mChannelAmplitudeTargets[(size_t)i] = jmin (1.0f, k * mInverseDistances[(size_t)i]);
+
+    dbapTargetsChanged();
+}
+
+void SpatialSynthVoice::cullDBAPTargets() noexcept
+{
+    auto& targets = mChannelAmplitudeTargets;
+    const int numSpeakers = (int)targets.size();
+    float minGain = mCullMinGain;
+
+    if (mCullMaxSpeakers > 0 && mCullMaxSpeakers < numSpeakers)
+    {
+        // The gain of the quietest speaker that makes the cut
+        mCullScratch.assign (targets.begin(), targets.end());
+        std::nth_element (mCullScratch.begin(), mCullScratch.begin() + (mCullMaxSpeakers - 1), mCullScratch.end(), std::greater<float>());
+        minGain = jmax (minGain, mCullScratch[(size_t)(mCullMaxSpeakers - 1)]);
+    }
+
+    if (minGain <= 0.0f)
+        return;
+
+    // Speakers tied with the quietest one are kept in index order, only as many as it
+    // takes to make up mCullMaxSpeakers with the ones that are louder
+    int numTiesToKeep = numSpeakers;
+
+    if (mCullMaxSpeakers > 0)
+        numTiesToKeep = mCullMaxSpeakers - (int)std::count_if (targets.begin(), targets.end(),
+                                                               [minGain] (float gain) { return gain > minGain; });
+
+    float energy = 0.0f;
+    float keptEnergy = 0.0f;
+
+    for (auto& gain : targets)
+    {
+        energy += gain * gain;
+
+        if (gain < minGain || (gain == minGain && --numTiesToKeep < 0))
+            gain = 0.0f;
+        else
+            keptEnergy += gain * gain;
+    }
+
+    if (keptEnergy > 0.0f && keptEnergy < energy)
+    {
+        const float scale = std::sqrt (energy / keptEnergy);
+
+        for (auto& gain : targets)
+            gain = jmin (1.0f, gain * scale);
+    }
+}
+
+void SpatialSynthVoice::updateActiveChannels() noexcept
+{
+    mActiveChannels.clear();
+
+    for (size_t i = 0; i < mChannelAmplitudeTargets.size(); ++i)
+        if (mChannelAmplitudeTargets[i] != 0.0f || mChannelAmplitudes[i] != 0.0f)
+            mActiveChannels.push_back ((int)i);
+}
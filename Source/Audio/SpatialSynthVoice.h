@@ -13,6 +13,10 @@
 #include "SpatialSynthSound.h"
 #include "vec3.hpp"
 
+class DBAPGainGrid;
+class AmbisonicPanner;
+class VBAPPanner;
+
 //==============================================================================
 /**
     Represents a voice that a SpatialSynth can use to play a SpatialSynthSound.
@@ -87,8 +91,8 @@ public:
     virtual void stopNote (float velocity, bool allowTailOff) = 0;
 
     /** Returns true if this voice is currently busy playing a sound.
-        By default this just checks the getCurrentlyPlayingNote() value, but can
-        be overridden for more advanced checking.
+        By default this just checks whether a sound is assigned (anonymous notes
+        use a negative noteID), but can be overridden for more advanced checking.
     */
     virtual bool isVoiceActive() const;
 
@@ -133,13 +137,45 @@ public:
     */
     virtual void setCurrentPlaybackSampleRate(double newRate);
     
+    /** Sets the number of speaker channels to pan across.
+        The storage for maxNumSpeakerOutputs channels is allocated up front, so this
+        can safely be called on the audio thread. Added channels start silent until
+        the next DBAP update.
+    */
     void setNumSpeakerOutputs(int numSpeakers);
+
+    static constexpr int maxNumSpeakerOutputs = 256;
+
+    /** Limits which speakers a voice is mixed into. Speakers whose DBAP gain is below
+        minGain are left out, and if maxSpeakers is above 0 only that many of the loudest
+        are used. The remaining gains are scaled up to keep the total energy the same.
+
+        Only the speakers a voice is mixed into cost anything to render, so on large
+        arrays this makes the cost of a voice depend on maxSpeakers rather than on the
+        size of the array.
+    */
+    void setDBAPCulling (float minGain, int maxSpeakers) noexcept;
     
     bool getNeedsDBAPUpdate() const { return mNeedsDBAPUpdate; }
 
+    /** Calculates the normalised DBAP gain of each speaker for a source at the given position. */
+    static void calculateDBAPGains (const std::vector<glm::vec3>& speakerPositions,
+                                    const glm::vec3& position,
+                                    float* gains,
+                                    int numSpeakers) noexcept;
+
     /** Returns true if this voice started playing its current note before the other voice did. */
     bool wasStartedBefore (const SpatialSynthVoice& other) const noexcept;
 
+    /** Returns a rough estimate of how loud this voice currently is, used to pick the
+        voice that will be missed least when one has to be stolen.
+
+        By default this is the sum of the DBAP gains. Subclasses should scale it by their
+        envelope and by how much of the sound is left to play.
+        This is called during the rendering callback, so must be fast and thread-safe.
+    */
+    virtual float getAudibility() const noexcept                 { return mGainSum; }
+
 protected:
     /** Resets the state of this voice after a sound has finished playing.
 
@@ -155,23 +191,101 @@ protected:
     */
     void clearCurrentNote();
     
-    void updateDBAPAmplitudes(const std::vector<glm::vec3>& positions);
+    /** Sets the DBAP targets for the voice's position. If a gain grid is given and the
+        position is inside it the gains are interpolated from the grid, otherwise they
+        are calculated exactly.
+    */
+    void updateDBAPAmplitudes(const std::vector<glm::vec3>& positions,
+                              const DBAPGainGrid* gainGrid = nullptr);
+
+    /** Calculates the per sample amplitude increments needed to reach the DBAP
+        targets by the end of a block of numSamples.
+        Call this once at the start of renderNextBlock().
+    */
+    void prepareAmplitudeRamps (int numSamples);
+
+    /** Adds a block of mono samples to each of the speaker channels of the output buffer.
+
+        Each channel is ramped from its current amplitude using the increments from
+        prepareAmplitudeRamps(), so a block can be mixed in several chunks as long as
+        the chunks add up to the numSamples that the ramps were prepared for.
+
+        The source only needs to be generated once per block, the per channel work is
+        then done with vectorised multiply-adds.
+    */
+    void addMonoToSpeakerChannels (const float* monoSamples,
+                                   AudioBuffer<float>& outputBuffer,
+                                   int startSample,
+                                   int numSamples);
+
+    /** Returns a scratch buffer that subclasses can render their mono source into.
+        It holds getScratchBlockSize() samples so longer blocks must be rendered in chunks.
+    */
+    float* getMonoScratchBuffer() noexcept                      { return mScratchBuffer.getWritePointer (0); }
+
+    static constexpr int getScratchBlockSize() noexcept         { return scratchBlockSize; }
 
     int                mCurrentNoteID = -1;
+    std::vector<int>   mActiveChannels;     // The channels with a non-zero amplitude or target
     std::vector<float> mChannelAmplitudes;
     std::vector<float> mChannelAmplitudeTargets;
     std::vector<float> mChannelAmplitudeIncrements;
     glm::vec3          mPosition;
     bool               mNeedsDBAPUpdate = true;
+    float              mGainSum = 1.0f;
 
 private:
     //==============================================================================
     friend class SpatialSynth;
 
+    static constexpr int    scratchBlockSize = 256;
+
+    /** Culls the new targets, then updates the active channels and the gain sum and
+        clears the DBAP flag.
+    */
+    void dbapTargetsChanged() noexcept;
+
+    /** Sets the targets to the voice's encoding gains in the panner's Ambisonic bus,
+        which is what the speaker channels hold while the synth pans with Ambisonics.
+    */
+    void updateAmbisonicAmplitudes (const AmbisonicPanner&) noexcept;
+
+    /** Sets the targets to the VBAP gains of the two or three speakers around the voice.
+        Only the channels that were already active are touched, so this doesn't depend
+        on the number of speakers.
+    */
+    void updateVBAPAmplitudes (const VBAPPanner&) noexcept;
+
+    /** Updates the DBAP targets after some of the speakers have moved. Only the distances
+        to the moved speakers are recalculated, as long as the voice hasn't moved since
+        the distances were last cached.
+    */
+    void updateDBAPForMovedSpeakers (const std::vector<glm::vec3>& positions,
+                                     const std::vector<int>& movedSpeakers) noexcept;
+
+    void cullDBAPTargets() noexcept;
+    void updateActiveChannels() noexcept;
+
+    float                   mCullMinGain = 0.0f;
+    int                     mCullMaxSpeakers = 0;
+    std::vector<float>      mCullScratch;
+    int                     mVBAPSetHint = 0;
+
+    // 1 / d^a to each speaker, cached for moving the speakers rather than the voice
+    std::vector<float>      mInverseDistances;
+    glm::vec3               mInverseDistancesPosition;
+    bool                    mInverseDistancesValid = false;
+
     double                  mCurrentSampleRate = 44100.0;
     uint32                  mNoteOnTime = 0;
+    bool                    mIsInActiveList = false;
+    int                     mMappedNoteID = -1;
+    SpatialSynthVoice*      mNextVoiceForNote = nullptr;    // An older voice mapped to the same noteID
     SpatialSynthSound::Ptr  mCurrentlyPlayingSound;
     AudioBuffer<float>      mTempBuffer;
 
+    // Channel 0 holds the mono source, channel 1 the same source scaled by a 0 -> 1 ramp
+    AudioBuffer<float>      mScratchBuffer { 2, scratchBlockSize };
+
     JUCE_LEAK_DETECTOR (SpatialSynthVoice)
 };
@@ -0,0 +1,382 @@
+/*
+  ==============================================================================
+
+    VBAPPanner.cpp
+    Created: 17 Oct 2026 10:26:08pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "VBAPPanner.h"
+#include "geometric.hpp"
+
+// Directions closer than this to a plane or line are treated as lying on it
+static const float vbapEpsilon = 1.0e-4f;
+
+
+//==============================================================================
+std::unique_ptr<VBAPPanner> VBAPPanner::build (const std::vector<glm::vec3>& speakerPositions)
+{
+    const int numSpeakers = (int)speakerPositions.size();
+
+    if (numSpeakers < 2)
+        return nullptr;
+
+    std::unique_ptr<VBAPPanner> panner (new VBAPPanner());
+    panner->mNumSpeakers = numSpeakers;
+    panner->mCentre = glm::vec3 (0.0f);
+
+    for (const auto& p : speakerPositions)
+        panner->mCentre += p;
+
+    panner->mCentre /= (float)numSpeakers;
+
+    // A speaker right in the middle has no direction and is left out
+    std::vector<glm::vec3> directions;
+    directions.reserve ((size_t)numSpeakers);
+
+    for (const auto& p : speakerPositions)
+    {
+        const glm::vec3 offset = p - panner->mCentre;
+        const float length = glm::length (offset);
+        directions.push_back (length > vbapEpsilon ? offset / length : glm::vec3 (0.0f));
+    }
+
+    if (! panner->triangulate (directions))
+    {
+        // Every direction is in one plane, which is spanned by the first two that aren't parallel
+        glm::vec3 normal (0.0f, 1.0f, 0.0f);
+
+        for (size_t i = 1; i < directions.size(); ++i)
+        {
+            const glm::vec3 n = glm::cross (directions[0], directions[i]);
+
+            if (glm::length (n) > vbapEpsilon)
+            {
+                normal = glm::normalize (n);
+                break;
+            }
+        }
+
+        panner->pairAroundPlane (directions, normal);
+    }
+
+    if (panner->mSets.empty())
+        return nullptr;
+
+    return panner;
+}
+
+bool VBAPPanner::triangulate (const std::vector<glm::vec3>& directions)
+{
+    const int numPoints = (int)directions.size();
+
+    struct Face
+    {
+        int a, b, c;
+        glm::vec3 normal;
+    };
+
+    const auto makeFace = [&directions] (int a, int b, int c)
+    {
+        const glm::vec3 n = glm::cross (directions[(size_t)b] - directions[(size_t)a],
+                                        directions[(size_t)c] - directions[(size_t)a]);
+        const float length = glm::length (n);
+        return Face { a, b, c, length > 0.0f ? n / length : glm::vec3 (0.0f) };
+    };
+
+    // Start with the largest tetrahedron we can easily find
+    int i0 = -1;
+
+    for (int i = 0; i < numPoints && i0 < 0; ++i)
+        if (directions[(size_t)i] != glm::vec3 (0.0f))
+            i0 = i;
+
+    if (i0 < 0)
+        return false;
+
+    const auto& d0 = directions[(size_t)i0];
+    int i1 = -1, i2 = -1, i3 = -1;
+    float best = vbapEpsilon;
+
+    for (int i = 0; i < numPoints; ++i)
+    {
+        const float distance = glm::length (directions[(size_t)i] - d0);
+
+        if (directions[(size_t)i] != glm::vec3 (0.0f) && distance > best)
+        {
+            best = distance;
+            i1 = i;
+        }
+    }
+
+    if (i1 < 0)
+        return false;
+
+    const glm::vec3 edge = directions[(size_t)i1] - d0;
+    best = vbapEpsilon;
+
+    for (int i = 0; i < numPoints; ++i)
+    {
+        const float distance = glm::length (glm::cross (edge, directions[(size_t)i] - d0));
+
+        if (directions[(size_t)i] != glm::vec3 (0.0f) && distance > best)
+        {
+            best = distance;
+            i2 = i;
+        }
+    }
+
+    if (i2 < 0)
+        return false;
+
+    const glm::vec3 planeNormal = glm::normalize (glm::cross (edge, directions[(size_t)i2] - d0));
+    best = vbapEpsilon;
+
+    for (int i = 0; i < numPoints; ++i)
+    {
+        const float distance = std::abs (glm::dot (planeNormal, directions[(size_t)i] - d0));
+
+        if (directions[(size_t)i] != glm::vec3 (0.0f) && distance > best)
+        {
+            best = distance;
+            i3 = i;
+        }
+    }
+
+    // Everything is in one plane
+    if (i3 < 0)
+        return false;
+
+    const glm::vec3 inside = (d0 + directions[(size_t)i1] + directions[(size_t)i2] + directions[(size_t)i3]) * 0.25f;
+    std::vector<Face> faces;
+
+    for (auto f : { makeFace (i0, i1, i2), makeFace (i0, i1, i3), makeFace (i0, i2, i3), makeFace (i1, i2, i3) })
+    {
+        // Wind every face so that its normal points outwards
+        if (glm::dot (f.normal, inside - directions[(size_t)f.a]) > 0.0f)
+            f = makeFace (f.a, f.c, f.b);
+
+        faces.push_back (f);
+    }
+
+    // Add the rest of the points one at a time, replacing the faces each one can see
+    std::vector<std::pair<int, int>> visibleEdges, horizon;
+
+    for (int i = 0; i < numPoints; ++i)
+    {
+        const auto& p = directions[(size_t)i];
+
+        if (i == i0 || i == i1 || i == i2 || i == i3 || p == glm::vec3 (0.0f))
+            continue;
+
+        visibleEdges.clear();
+
+        for (size_t f = faces.size(); f-- > 0;)
+        {
+            const auto& face = faces[f];
+
+            if (glm::dot (face.normal, p - directions[(size_t)face.a]) > vbapEpsilon)
+            {
+                visibleEdges.push_back ({ face.a, face.b });
+                visibleEdges.push_back ({ face.b, face.c });
+                visibleEdges.push_back ({ face.c, face.a });
+
+                faces[f] = faces.back();
+                faces.pop_back();
+            }
+        }
+
+        // Inside the hull, or sharing a direction with a speaker that's already in it
+        if (visibleEdges.empty())
+            continue;
+
+        // The horizon is the edges of the visible faces that aren't shared with another visible face
+        horizon.clear();
+
+        for (const auto& e : visibleEdges)
+            if (std::find (visibleEdges.begin(), visibleEdges.end(), std::make_pair (e.second, e.first)) == visibleEdges.end())
+                horizon.push_back (e);
+
+        for (const auto& e : horizon)
+            faces.push_back (makeFace (e.first, e.second, i));
+    }
+
+    for (const auto& face : faces)
+    {
+        const auto& a = directions[(size_t)face.a];
+        const auto& b = directions[(size_t)face.b];
+        const auto& c = directions[(size_t)face.c];
+
+        // Invert the matrix with the three directions as its columns
+        const float det = glm::dot (a, glm::cross (b, c));
+
+        if (std::abs (det) < vbapEpsilon)
+            continue;
+
+        const glm::vec3 rows[3] = { glm::cross (b, c) / det,
+                                    glm::cross (c, a) / det,
+                                    glm::cross (a, b) / det };
+
+        SpeakerSet set;
+        set.speakers[0] = face.a;
+        set.speakers[1] = face.b;
+        set.speakers[2] = face.c;
+
+        for (int r = 0; r < 3; ++r)
+        {
+            set.inverse[r * 3]     = rows[r].x;
+            set.inverse[r * 3 + 1] = rows[r].y;
+            set.inverse[r * 3 + 2] = rows[r].z;
+        }
+
+        mSets.push_back (set);
+    }
+
+    return true;
+}
+
+void VBAPPanner::pairAroundPlane (const std::vector<glm::vec3>& directions, const glm::vec3& normal)
+{
+    mIs2D = true;
+
+    // Any two axes in the plane will do
+    const glm::vec3 reference = std::abs (normal.x) < 0.9f ? glm::vec3 (1.0f, 0.0f, 0.0f) : glm::vec3 (0.0f, 0.0f, 1.0f);
+    mPlaneX = glm::normalize (glm::cross (normal, reference));
+    mPlaneY = glm::cross (normal, mPlaneX);
+
+    struct Speaker
+    {
+        int index;
+        float angle, x, y;
+    };
+
+    std::vector<Speaker> speakers;
+
+    for (size_t i = 0; i < directions.size(); ++i)
+    {
+        const float x = glm::dot (directions[i], mPlaneX);
+        const float y = glm::dot (directions[i], mPlaneY);
+        const float length = std::sqrt (x * x + y * y);
+
+        if (length > vbapEpsilon)
+            speakers.push_back ({ (int)i, std::atan2 (y, x), x / length, y / length });
+    }
+
+    std::sort (speakers.begin(), speakers.end(), [] (const Speaker& a, const Speaker& b) { return a.angle < b.angle; });
+
+    const int numSpeakers = (int)speakers.size();
+
+    if (numSpeakers < 2)
+        return;
+
+    for (int i = 0; i < numSpeakers; ++i)
+    {
+        const auto& a = speakers[(size_t)i];
+        const auto& b = speakers[(size_t)((i + 1) % numSpeakers)];
+
+        float gap = b.angle - a.angle;
+
+        if (gap <= 0.0f)
+            gap += MathConstants<float>::twoPi;
+
+        // Speakers in the same direction, or so far apart that there's no pair to pan between
+        if (gap < vbapEpsilon || gap > MathConstants<float>::pi - vbapEpsilon)
+            continue;
+
+        const float det = a.x * b.y - b.x * a.y;
+
+        SpeakerSet set;
+        set.speakers[0] = a.index;
+        set.speakers[1] = b.index;
+        set.inverse[0] =  b.y / det;
+        set.inverse[1] = -b.x / det;
+        set.inverse[2] = -a.y / det;
+        set.inverse[3] =  a.x / det;
+        mSets.push_back (set);
+    }
+}
+
+//==============================================================================
+float VBAPPanner::getSetGains (const SpeakerSet& set, const glm::vec3& direction, float* gains) const noexcept
+{
+    const float* m = set.inverse;
+
+    if (mIs2D)
+    {
+        const float x = glm::dot (direction, mPlaneX);
+        const float y = glm::dot (direction, mPlaneY);
+
+        gains[0] = m[0] * x + m[1] * y;
+        gains[1] = m[2] * x + m[3] * y;
+        return jmin (gains[0], gains[1]);
+    }
+
+    gains[0] = m[0] * direction.x + m[1] * direction.y + m[2] * direction.z;
+    gains[1] = m[3] * direction.x + m[4] * direction.y + m[5] * direction.z;
+    gains[2] = m[6] * direction.x + m[7] * direction.y + m[8] * direction.z;
+    return jmin (gains[0], gains[1], gains[2]);
+}
+
+int VBAPPanner::getGains (const glm::vec3& position, int& setHint, int* speakers, float* gains) const noexcept
+{
+    const int numSets = (int)mSets.size();
+    const int setSize = mIs2D ? 2 : 3;
+
+    if (numSets == 0)
+        return 0;
+
+    const glm::vec3 offset = position - mCentre;
+    const float length = glm::length (offset);
+    const glm::vec3 direction = length > vbapEpsilon ? offset / length : glm::vec3 (0.0f);
+
+    int best = jlimit (0, numSets - 1, setHint);
+    float bestMin = getSetGains (mSets[(size_t)best], direction, gains);
+
+    // The direction is inside a set when none of its gains are negative, otherwise
+    // search for the set it's in, or failing that the one it's closest to
+    if (bestMin < -vbapEpsilon)
+    {
+        float candidate[3];
+
+        for (int i = 0; i < numSets; ++i)
+        {
+            if (i == setHint)
+                continue;
+
+            const float candidateMin = getSetGains (mSets[(size_t)i], direction, candidate);
+
+            if (candidateMin > bestMin)
+            {
+                best = i;
+                bestMin = candidateMin;
+                std::copy (candidate, candidate + setSize, gains);
+
+                if (candidateMin >= -vbapEpsilon)
+                    break;
+            }
+        }
+    }
+
+    setHint = best;
+
+    float energy = 0.0f;
+
+    for (int i = 0; i < setSize; ++i)
+    {
+        gains[i] = jmax (0.0f, gains[i]);
+        energy += gains[i] * gains[i];
+    }
+
+    // A source with no direction (in the middle of the speakers) is spread evenly
+    const float scale = energy > 0.0f ? 1.0f / std::sqrt (energy) : 0.0f;
+
+    for (int i = 0; i < setSize; ++i)
+    {
+        speakers[i] = mSets[(size_t)best].speakers[i];
+        gains[i] = energy > 0.0f ? gains[i] * scale : 1.0f / std::sqrt ((float)setSize);
+    }
+
+    return setSize;
+}
@@ -0,0 +1,78 @@
+/*
+  ==============================================================================
+
+    VBAPPanner.h
+    Created: 17 Oct 2026 10:26:08pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "vec3.hpp"
+
+//==============================================================================
+/**
+    Vector base amplitude panning over a triangulation of the speakers.
+
+    The directions of the speakers seen from their centre are triangulated once per
+    layout by taking their convex hull, and the inverse of each triangle's matrix of
+    speaker directions is stored. A source then only needs the triangle that its
+    direction falls in, and is mixed into those three speakers.
+
+    When all the speakers lie in one plane (a ring, say) the layout is treated as 2D
+    and pairs of neighbouring speakers are used instead. Speakers that share a
+    direction with another one never receive any signal.
+
+    @see SpatialSynth
+*/
+class VBAPPanner
+{
+public:
+    //==============================================================================
+    /** Triangulates the speakers.  (Not the audio thread)
+        Returns nullptr if there aren't enough speakers to pan between.
+    */
+    static std::unique_ptr<VBAPPanner> build (const std::vector<glm::vec3>& speakerPositions);
+
+    int getNumSpeakers() const noexcept                 { return mNumSpeakers; }
+    int getNumSpeakerSets() const noexcept              { return (int)mSets.size(); }
+    bool is2D() const noexcept                          { return mIs2D; }
+
+    /** Writes the speakers and normalised gains for a source at the given position and
+        returns how many there are, at most maxSpeakersPerSource.
+
+        setHint is the index of the speaker set the source was last found in. It's
+        checked first and updated, so a source that moves smoothly rarely needs a search.
+    */
+    int getGains (const glm::vec3& position, int& setHint, int* speakers, float* gains) const noexcept;
+
+    static constexpr int maxSpeakersPerSource = 3;
+
+private:
+    //==============================================================================
+    VBAPPanner() = default;
+
+    /** A triangle (or pair) of speakers and the inverse of the matrix of their directions. */
+    struct SpeakerSet
+    {
+        int     speakers[3] = { -1, -1, -1 };
+        float   inverse[9] = {};
+    };
+
+    bool triangulate (const std::vector<glm::vec3>& directions);
+    void pairAroundPlane (const std::vector<glm::vec3>& directions, const glm::vec3& normal);
+
+    /** Writes the gains of a set for the direction and returns the smallest of them. */
+    float getSetGains (const SpeakerSet&, const glm::vec3& direction, float* gains) const noexcept;
+
+    int                     mNumSpeakers = 0;
+    bool                    mIs2D = false;
+    glm::vec3               mCentre;
+    glm::vec3               mPlaneX, mPlaneY;   // the plane of a 2D layout
+    std::vector<SpeakerSet> mSets;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VBAPPanner)
+};
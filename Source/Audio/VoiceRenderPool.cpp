@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+    VoiceRenderPool.cpp
+    Created: 17 Oct 2026 2:31:08pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "VoiceRenderPool.h"
+
+
+//==============================================================================
+class VoiceRenderPool::Worker  : public Thread
+{
+public:
+    Worker (VoiceRenderPool& owner, int partitionIndex)
+        : Thread ("Voice Render Worker " + String (partitionIndex)),
+          mPartitionIndex (partitionIndex),
+          mOwner (owner)
+    {
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            if (! mStartEvent.wait (100))
+                continue;
+
+            if (threadShouldExit())
+                break;
+
+            mOwner.renderUnclaimedPartition (*this);
+        }
+    }
+
+    WaitableEvent       mStartEvent;
+    AudioBuffer<float>  mBuffer;
+    const int           mPartitionIndex;
+
+    // Set by the thread that renders this partition, and only cleared by render() when
+    // the next job starts. A worker woken late by an old signal therefore finds it set
+    std::atomic<bool>   mIsClaimed { true };
+
+private:
+    VoiceRenderPool&    mOwner;
+};
+
+
+//==============================================================================
+VoiceRenderPool::VoiceRenderPool (int numWorkerThreads)
+{
+    // Partition 0 is rendered by the calling thread
+    for (int i = 0; i < numWorkerThreads; ++i)
+        mWorkers.add (new Worker (*this, i + 1));
+
+    for (auto* worker : mWorkers)
+        worker->startThread (Thread::realtimeAudioPriority);
+}
+
+VoiceRenderPool::~VoiceRenderPool()
+{
+    for (auto* worker : mWorkers)
+    {
+        worker->signalThreadShouldExit();
+        worker->mStartEvent.signal();
+    }
+
+    for (auto* worker : mWorkers)
+        worker->stopThread (1000);
+}
+
+void VoiceRenderPool::prepare (int numChannels, int maximumBlockSize)
+{
+    mNumChannels = numChannels;
+    mMaximumBlockSize = maximumBlockSize;
+
+    mCallerBuffer.setSize (numChannels, maximumBlockSize);
+
+    for (auto* worker : mWorkers)
+        worker->mBuffer.setSize (numChannels, maximumBlockSize);
+}
+
+bool VoiceRenderPool::render (const std::vector<SpatialSynthVoice*>& voices,
+                              AudioBuffer<float>& outputBuffer,
+                              int startSample,
+                              int numSamples)
+{
+    if (numSamples > mMaximumBlockSize || outputBuffer.getNumChannels() != mNumChannels)
+        return false;
+
+    mJobVoices = &voices;
+    mJobNumSamples = numSamples;
+
+    // These must be set before any of the partitions can be claimed
+    mNumUnfinishedPartitions = mWorkers.size();
+
+    for (auto* worker : mWorkers)
+    {
+        worker->mIsClaimed = false;
+        worker->mStartEvent.signal();
+    }
+
+    renderPartition (0, mCallerBuffer);
+
+    // Rather than waiting for workers that haven't been scheduled yet, render any
+    // partitions they haven't started here
+    for (auto* worker : mWorkers)
+        renderUnclaimedPartition (*worker);
+
+    // Only the partitions a worker is already rendering are left to wait for. A signal
+    // left over from an earlier job just goes round the loop again
+    while (mNumUnfinishedPartitions.load() > 0)
+        mJobFinished.wait();
+
+    // Sum the partitions in a fixed order so the result doesn't depend on thread timing
+    for (int ch = 0; ch < mNumChannels; ++ch)
+    {
+        float* out = outputBuffer.getWritePointer (ch, startSample);
+
+        FloatVectorOperations::add (out, mCallerBuffer.getReadPointer (ch), numSamples);
+
+        for (auto* worker : mWorkers)
+            FloatVectorOperations::add (out, worker->mBuffer.getReadPointer (ch), numSamples);
+    }
+
+    mJobVoices = nullptr;
+    return true;
+}
+
+void VoiceRenderPool::renderPartition (int partitionIndex, AudioBuffer<float>& partitionBuffer)
+{
+    jassert (mJobVoices != nullptr);
+
+    const auto& voices = *mJobVoices;
+    const int numPartitions = mWorkers.size() + 1;
+
+    for (int ch = 0; ch < mNumChannels; ++ch)
+        FloatVectorOperations::clear (partitionBuffer.getWritePointer (ch), mJobNumSamples);
+
+    for (int i = partitionIndex; i < (int)voices.size(); i += numPartitions)
+        voices[(size_t)i]->renderNextBlock (partitionBuffer, 0, mJobNumSamples);
+}
+
+void VoiceRenderPool::renderUnclaimedPartition (Worker& worker)
+{
+    // A job can't finish while one of its partitions is claimed but not rendered, so a
+    // successful claim always belongs to the job that render() is currently running
+    if (worker.mIsClaimed.exchange (true))
+        return;
+
+    renderPartition (worker.mPartitionIndex, worker.mBuffer);
+
+    // The last partition to finish wakes up the audio thread
+    if (--mNumUnfinishedPartitions == 0)
+        mJobFinished.signal();
+}
@@ -0,0 +1,90 @@
+/*
+  ==============================================================================
+
+    VoiceRenderPool.h
+    Created: 17 Oct 2026 2:31:08pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include "SpatialSynthVoice.h"
+
+//==============================================================================
+/**
+    A fixed pool of realtime worker threads that render a SpatialSynth's voices
+    in parallel.
+
+    The voices are dealt out across the calling thread and the workers (voice i
+    goes to partition i % numPartitions), each partition mixes into its own
+    preallocated buffer, and the buffers are then added to the output in partition
+    order. The same set of voices therefore always produces the same output,
+    whichever thread happens to finish first.
+
+    Each worker partition is claimed by whichever thread gets to it first. After
+    rendering its own partition the calling thread claims any that the workers
+    haven't started, so a worker that hasn't been scheduled yet never holds up the
+    block. A claimed partition is always rendered into that partition's buffer, so
+    the summing order doesn't depend on who rendered it. The calling thread only
+    waits for partitions that a worker is already rendering.
+
+    @see SpatialSynth
+*/
+class VoiceRenderPool
+{
+public:
+    //==============================================================================
+    /** Creates and starts the worker threads. */
+    explicit VoiceRenderPool (int numWorkerThreads);
+
+    /** Stops the worker threads. */
+    ~VoiceRenderPool();
+
+    //==============================================================================
+    /** Allocates the per partition mixing buffers.
+        This must not be called while render() is running.
+    */
+    void prepare (int numChannels, int maximumBlockSize);
+
+    /** Returns the number of worker threads, not counting the calling thread. */
+    int getNumWorkerThreads() const noexcept            { return mWorkers.size(); }
+
+    /** Renders the voices into the output buffer, adding to its existing contents.
+
+        Returns false without rendering anything if the block is larger than the
+        buffers given to prepare(), in which case the caller should render serially.
+    */
+    bool render (const std::vector<SpatialSynthVoice*>& voices,
+                 AudioBuffer<float>& outputBuffer,
+                 int startSample,
+                 int numSamples);
+
+private:
+    //==============================================================================
+    class Worker;
+
+    void renderPartition (int partitionIndex, AudioBuffer<float>& partitionBuffer);
+
+    /** Renders a worker's partition into the worker's buffer, unless another thread
+        has already claimed it for the current job.
+    */
+    void renderUnclaimedPartition (Worker&);
+
+    OwnedArray<Worker>                  mWorkers;
+    AudioBuffer<float>                  mCallerBuffer;
+
+    // Current job, only valid while render() is running
+    const std::vector<SpatialSynthVoice*>* mJobVoices = nullptr;
+    int                                 mJobNumSamples = 0;
+    std::atomic<int>                    mNumUnfinishedPartitions { 0 };
+    WaitableEvent                       mJobFinished;
+
+    int                                 mNumChannels = 0;
+    int                                 mMaximumBlockSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VoiceRenderPool)
+};
@@ -11,18 +11,28 @@
 
 //==============================================================================
 MainComponent::MainComponent()
-    : mAudio(mModel.mDeviceManager)
+    : mAudio(mModel.mDeviceManager),
+      mOSCEventListener(mModel.mOSCReciever, mAudio)
 {
     // Init model
     mModel.mSpeakerPositionsState.addChangeListener(this);
     mModel.mAudioDataState.addChangeListener(this);
     mModel.mAtmosphereLevelState.addChangeListener(this);
-    mModel.mOSCReciever.addListener(this);
+    mModel.mAudioEngineSettingsState.addChangeListener(this);
     AppModelLoader::loadSettings(mModel);
 
     // Init Audio
+    mAudio.setEventQueueCapacity(mModel.mAudioEngineSettingsState.getEventQueueCapacity());
     mAudio.initialise();
     mAudio.mSynth.updateSpeakerPositions(mModel.mSpeakerPositionsState.getPositions());
+    mAudio.mSynth.setDBAPGridResolution(mModel.mAudioEngineSettingsState.getDBAPGridResolution());
+    mAudio.mSynth.setDBAPCulling(mModel.mAudioEngineSettingsState.getDBAPCullThresholdDb(),
+                                 mModel.mAudioEngineSettingsState.getDBAPMaxSpeakersPerVoice());
+    mAudio.mSynth.setPanningMode(mModel.mAudioEngineSettingsState.getPanningMode(),
+                                 mModel.mAudioEngineSettingsState.getAmbisonicOrder());
+    mAudio.setNumVoices(mModel.mAudioEngineSettingsState.getNumVoices());
+    mAudio.setAtmosphereStreamingThreshold(mModel.mAudioEngineSettingsState.getAtmosphereStreamingThresholdBytes());
+    mAudio.setUseClipCache(mModel.mAudioEngineSettingsState.getUseClipCache());
     mAudio.loadAudioFiles(mModel.mAudioDataState);
     
     // Init UI
@@ -64,29 +74,31 @@ MainComponent::~MainComponent()
 
 // ===== CONTROLLER ====================================================
 
-void MainComponent::triggerSource(int noteID, int soundID, const glm::vec3& pos)
+void MainComponent::handleOSCEvents()
 {
-    const int numClips = (int)mModel.mAudioDataState.mSoundClipData.size();
+    // The audio engine has already had these, they are copied here for the visualisation
+    SoundEvent e;
 
-    jassert(soundID < numClips);
-
-    if (soundID >= numClips || soundID < 0)
-        return; // TODO: push error message to app console
-
-    // Audio
-    mAudio.addSoundEvent({noteID, soundID, pos});
+    while (mOSCEventListener.popVisualEvent(e))
+    {
+        if (e.isStartNote())
+        {
+            // The clips may have changed since the event was sent
+            if (e.soundID < (int)mModel.mAudioDataState.mSoundClipData.size())
+                mModel.mVisualVoiceState.addSound(e.noteID, mModel.mAudioDataState.mSoundClipData[e.soundID], e.position);
+        }
+        else
+        {
+            mModel.mVisualVoiceState.updateSound(e.noteID, e.position);
+        }
+    }
 
-    // Visualisation
-    const auto& fileData = mModel.mAudioDataState.mSoundClipData[soundID];
-    mModel.mVisualVoiceState.addSound(noteID, fileData, pos);
-}
+    OSCEventListener::AtmosphereLevel atmosphere;
 
-void MainComponent::updateSource(int noteID, const glm::vec3& pos)
-{
-    mAudio.addSoundEvent({noteID, -1, pos});
+    while (mOSCEventListener.popAtmosphereLevel(atmosphere))
+        mModel.mAtmosphereLevelState.setSoundAtmosphereAmplitude(atmosphere.index, atmosphere.level);
 
-    // Visualisation
-    mModel.mVisualVoiceState.updateSound(noteID, pos);
+    mOSCEventListener.updateMessageRate();
 }
 
 void MainComponent::allNotesOff()
@@ -135,8 +147,22 @@ void MainComponent::changeListenerCallback(ChangeBroadcaster* source)
     {
         mAudio.setSoundAtmosphereAmplitudes(mModel.mAtmosphereLevelState.getSoundAtmosphereAmpitudes());
     }
+    else if (source == &mModel.mAudioEngineSettingsState)
+    {
+        mAudio.mSynth.setNumRenderThreads(mModel.mAudioEngineSettingsState.getNumRenderThreads());
+        mAudio.mSynth.setDBAPGridResolution(mModel.mAudioEngineSettingsState.getDBAPGridResolution());
+        mAudio.mSynth.setDBAPCulling(mModel.mAudioEngineSettingsState.getDBAPCullThresholdDb(),
+                                     mModel.mAudioEngineSettingsState.getDBAPMaxSpeakersPerVoice());
+        mAudio.mSynth.setPanningMode(mModel.mAudioEngineSettingsState.getPanningMode(),
+                                     mModel.mAudioEngineSettingsState.getAmbisonicOrder());
+        mAudio.setNumVoices(mModel.mAudioEngineSettingsState.getNumVoices());
+        mAudio.setAtmosphereStreamingThreshold(mModel.mAudioEngineSettingsState.getAtmosphereStreamingThresholdBytes());
+        mAudio.setUseClipCache(mModel.mAudioEngineSettingsState.getUseClipCache());
+    }
     else if (source == &mModel.mAudioDataState)
     {
+        mOSCEventListener.setSoundData(mModel.mAudioDataState);
+
         const int numAtmospheres = (int)mModel.mAudioDataState.mSoundAtmosphereData.size();
         const int numAtmosphereLevels = (int)mModel.mAtmosphereLevelState.getSoundAtmosphereAmpitudes().size();
 
@@ -145,94 +171,13 @@ void MainComponent::changeListenerCallback(ChangeBroadcaster* source)
     }
 }
 
-void MainComponent::oscMessageReceived(const OSCMessage& message)
-{
-    // TODO: convert this to not use strings
-    if (message.getAddressPattern().toString() == "/start")
-    {
-        if (message[0].isInt32() // noteID
-         && message[1].isInt32() // soundID
-         && message[2].isFloat32() && message[3].isFloat32() && message[4].isFloat32())
-        {
-            const int soundID = message[0].getInt32();
-            const int noteID = message[1].getInt32();
-            const float x = message[2].getFloat32();
-            const float y = message[3].getFloat32();
-            const float z = message[4].getFloat32();
-            triggerSource(noteID, soundID, glm::vec3(x, y, z));
-        }
-        else if (message[0].isString() // soundAddress
-              && message[1].isInt32()  // noteID
-              && message[2].isFloat32() && message[3].isFloat32() && message[4].isFloat32())
-        {
-            const int soundID = mModel.mAudioDataState.getSoundIndexFromClipAddress(message[0].getString());
-            const int noteID = message[1].getInt32();
-            const float x = message[2].getFloat32();
-            const float y = message[3].getFloat32();
-            const float z = message[4].getFloat32();
-            triggerSource(noteID, soundID, glm::vec3(x, y, z));
-        }
-        else if (message[0].isInt32() // soundID
-              && message[1].isFloat32() && message[2].isFloat32() && message[3].isFloat32())
-        {
-            const int noteID = -1;
-            const int soundID = message[0].getInt32();
-            const float x = message[1].getFloat32();
-            const float y = message[2].getFloat32();
-            const float z = message[3].getFloat32();
-            triggerSource(noteID, soundID, glm::vec3(x, y, z));
-        }
-        else if (message[0].isString() // soundAddress
-              && message[1].isFloat32() && message[2].isFloat32() && message[3].isFloat32())
-        {
-            const int noteID = -1;
-            const int soundID = mModel.mAudioDataState.getSoundIndexFromClipAddress(message[0].getString());
-            const float x = message[1].getFloat32();
-            const float y = message[2].getFloat32();
-            const float z = message[3].getFloat32();
-            triggerSource(noteID, soundID, glm::vec3(x, y, z));
-        }
-        else
-        {
-            DBG("Incorrect message type");
-        }
-    }
-    else if (message.getAddressPattern().toString() == "/update")
-    {
-        if (message[0].isInt32())
-        {
-            const int noteID = message[0].getInt32();
-            const float x = message[1].getFloat32();
-            const float y = message[2].getFloat32();
-            const float z = message[3].getFloat32();
-            updateSource(noteID, glm::vec3(x, y, z));
-        }
-        else
-        {
-            DBG("Incorrect message type");
-        }
-    }
-    else if (message.getAddressPattern().toString() == "/atmosphere")
-    {
-        if (message[0].isInt32()
-         && message[1].isFloat32())
-        {
-            const int atmosphereIndex = message[0].getInt32();
-            const float level = message[1].getFloat32();
-         
-            mModel.mAtmosphereLevelState.setSoundAtmosphereAmplitude(atmosphereIndex, level);
-        }
-        else
-        {
-            DBG("Incorrect message type");
-        }
-    }
-}
-
 // Animation timer callback
 void MainComponent::timerCallback()
 {
+    handleOSCEvents();
+
     // Update output audio levels
+    mModel.mAudioMonitorState.setEventQueueStatistics(mAudio.getEventQueueStatistics());
     const auto& levels = mAudio.getAudioLevels();
     mModel.mAudioMonitorState.setAudioLevels(levels);
 
@@ -12,6 +12,7 @@
 
 #include "State/AppModel.h"
 #include "Audio/AudioController.h"
+#include "OSC/OSCEventListener.h"
 
 #include "Pages/IOSettingsComponent.h"
 #include "Pages/AudioFileListComponent.h"
@@ -28,7 +29,6 @@
 */
 class MainComponent   : public Component,
                         public ChangeListener,
-                        private OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>,
                         private Timer
 {
 public:
@@ -43,25 +43,28 @@ public:
     bool keyPressed(const KeyPress& event) override;
 
     // Controller
-    void triggerSource(int noteID, int soundID, const glm::vec3& pos);
-    void updateSource(int noteID, const glm::vec3& pos);
     void allNotesOff();
     
     // Callbacks
     void changeListenerCallback (ChangeBroadcaster* source) override;
-    void oscMessageReceived(const OSCMessage& message) override;
         
 private:
     //==============================================================================
 
     void timerCallback() override;
 
+    // Applies the OSC events that have been played to the visualisation
+    void handleOSCEvents();
+
     // Model
     AppModel                                      mModel;
     
     // Audio
     AudioController                               mAudio;
 
+    // OSC events go straight from the receive thread to the audio engine
+    OSCEventListener                              mOSCEventListener;
+
     // UI
     std::unique_ptr<ExpandingPageContainer>       mPagesContainer;
     
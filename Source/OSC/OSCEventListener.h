@@ -0,0 +1,326 @@
+/*
+  ==============================================================================
+
+    OSCEventListener.h
+    Created: 17 Oct 2026 7:41:05pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "juce_osc/juce_osc.h"
+
+#include "../Audio/AudioController.h"
+#include "../Audio/LockFreeFifo.h"
+#include "../Audio/RealtimeSnapshot.h"
+#include "../State/AudioDataState.h"
+
+//==============================================================================
+/** Parses incoming OSC messages on the OSC receive thread and passes the sound
+    events straight to the audio engine, so they never wait behind the GUI.
+
+    The message thread gets a copy of each event afterwards for the visualisation,
+    which it collects with popVisualEvent() whenever it has time.
+*/
+class OSCEventListener  : private OSCReceiver::Listener<OSCReceiver::RealtimeCallback>
+{
+public:
+    OSCEventListener(OSCReceiver& receiver, AudioController& audio)
+        : mReceiver(receiver),
+          mEventProducer(audio.createEventProducer())
+    {
+        jassert(mEventProducer != nullptr);
+        mReceiver.addListener(this);
+    }
+
+    ~OSCEventListener()
+    {
+        mReceiver.removeListener(this);
+    }
+
+    struct AtmosphereLevel
+    {
+        int     index = 0;
+        float   level = 0.0f;
+    };
+
+    /** Updates the addresses that sounds can be triggered by.  (Message thread only) */
+    void setSoundData(const AudioDataState& data)
+    {
+        mAddressIndex.publish(std::make_unique<SoundAddressIndex>(data.mSoundClipData, data.mSoundAtmosphereData));
+    }
+
+    /** Takes the next event that has been sent to the audio engine.  (Message thread only) */
+    bool popVisualEvent(SoundEvent& event)              { return mVisualEvents.pop(event); }
+
+    /** Takes the next atmosphere level change.  (Message thread only) */
+    bool popAtmosphereLevel(AtmosphereLevel& level)     { return mAtmosphereLevels.pop(level); }
+
+    //==============================================================================
+    uint32  getNumMessagesReceived() const noexcept     { return mNumMessagesReceived.load(); }
+
+    /** Messages with an address that isn't one of ours. */
+    uint32  getNumMessagesUnhandled() const noexcept    { return mNumMessagesUnhandled.load(); }
+
+    /** Messages with a known address but the wrong arguments or an unknown sound. */
+    uint32  getNumMessagesMalformed() const noexcept    { return mNumMessagesMalformed.load(); }
+
+    /** Measures the incoming message rate, call this regularly.  (Message thread only) */
+    void updateMessageRate()
+    {
+        const uint32 numReceived = mNumMessagesReceived.load();
+        const double now = Time::getMillisecondCounterHiRes();
+
+        if (now - mLastRateTime < 500.0)
+            return;
+
+        if (mLastRateTime > 0.0)
+            mMessagesPerSecond = (float)((numReceived - mLastNumMessagesReceived) * 1000.0 / (now - mLastRateTime));
+
+        mLastNumMessagesReceived = numReceived;
+        mLastRateTime = now;
+    }
+
+    float   getMessagesPerSecond() const noexcept       { return mMessagesPerSecond; }
+
+private:
+    //==============================================================================
+    void oscMessageReceived(const OSCMessage& message) override
+    {
+        mAddressIndex.update();
+        handleMessage(message, 0.0);
+    }
+
+    void oscBundleReceived(const OSCBundle& bundle) override
+    {
+        mAddressIndex.update();
+        handleBundle(bundle, 0.0);
+    }
+
+    void handleBundle(const OSCBundle& bundle, double time)
+    {
+        // Bundles tagged to play immediately use the time of the bundle they're in
+        if (! bundle.getTimeTag().isImmediately())
+            time = getEventTime(bundle.getTimeTag());
+
+        for (const auto& element : bundle)
+        {
+            if (element.isMessage())
+                handleMessage(element.getMessage(), time);
+            else if (element.isBundle())
+                handleBundle(element.getBundle(), time);
+        }
+    }
+
+    void handleMessage(const OSCMessage& message, double time)
+    {
+        ++mNumMessagesReceived;
+
+        const auto& pattern = message.getAddressPattern();
+
+        // A pattern without wildcards is matched against the parsed route addresses with a
+        // plain string compare, so routing never builds a String. Wildcards are matched in full.
+        bool handled = false;
+
+        for (const auto& route : mRoutes)
+        {
+            if (pattern.matches(route.address))
+            {
+                if (! (this->*route.handler)(message, time))
+                    ++mNumMessagesMalformed;
+
+                handled = true;
+            }
+        }
+
+        if (! handled)
+            ++mNumMessagesUnhandled;
+    }
+
+    //==============================================================================
+    // Each handler returns false if the message didn't have the right arguments,
+    // or referred to a sound that isn't loaded
+
+    bool handleStart(const OSCMessage& message, double time)
+    {
+        if (message.size() >= 5
+         && message[0].isInt32() // soundID
+         && message[1].isInt32() // noteID
+         && message[2].isFloat32() && message[3].isFloat32() && message[4].isFloat32())
+        {
+            const int soundID = message[0].getInt32();
+            const int noteID = message[1].getInt32();
+            return triggerSource(noteID, soundID, getPosition(message, 2), time);
+        }
+        else if (message.size() >= 5
+              && message[0].isString() // soundAddress
+              && message[1].isInt32()  // noteID
+              && message[2].isFloat32() && message[3].isFloat32() && message[4].isFloat32())
+        {
+            const int soundID = getSoundIndexFromClipAddress(message[0].getString());
+            const int noteID = message[1].getInt32();
+            return triggerSource(noteID, soundID, getPosition(message, 2), time);
+        }
+        else if (message.size() >= 4
+              && message[0].isInt32() // soundID
+              && message[1].isFloat32() && message[2].isFloat32() && message[3].isFloat32())
+        {
+            const int noteID = -1;
+            const int soundID = message[0].getInt32();
+            return triggerSource(noteID, soundID, getPosition(message, 1), time);
+        }
+        else if (message.size() >= 4
+              && message[0].isString() // soundAddress
+              && message[1].isFloat32() && message[2].isFloat32() && message[3].isFloat32())
+        {
+            const int noteID = -1;
+            const int soundID = getSoundIndexFromClipAddress(message[0].getString());
+            return triggerSource(noteID, soundID, getPosition(message, 1), time);
+        }
+
+        return false;
+    }
+
+    bool handleUpdate(const OSCMessage& message, double time)
+    {
+        if (message.size() < 4
+         || ! message[0].isInt32()
+         || ! (message[1].isFloat32() && message[2].isFloat32() && message[3].isFloat32()))
+            return false;
+
+        updateSource(message[0].getInt32(), getPosition(message, 1), time);
+        return true;
+    }
+
+    bool handleAtmosphere(const OSCMessage& message, double /*time*/)
+    {
+        if (message.size() < 2 || ! message[1].isFloat32())
+            return false;
+
+        int atmosphereIndex = -1;
+
+        if (message[0].isInt32())
+            atmosphereIndex = message[0].getInt32();
+        else if (message[0].isString() && mAddressIndex.get() != nullptr)
+            atmosphereIndex = mAddressIndex->getAtmosphereIndex(message[0].getString());
+        else
+            return false;
+
+        if (atmosphereIndex < 0)
+            return false;
+
+        mAtmosphereLevels.push({ atmosphereIndex, message[1].getFloat32() });
+        return true;
+    }
+
+    static glm::vec3 getPosition(const OSCMessage& message, int firstIndex)
+    {
+        return glm::vec3(message[firstIndex].getFloat32(),
+                         message[firstIndex + 1].getFloat32(),
+                         message[firstIndex + 2].getFloat32());
+    }
+
+    bool triggerSource(int noteID, int soundID, const glm::vec3& pos, double time)
+    {
+        const int numClips = mAddressIndex.get() != nullptr ? mAddressIndex->getNumClips() : 0;
+
+        if (soundID >= numClips || soundID < 0)
+            return false;
+
+        addEvent({noteID, soundID, pos, time});
+        return true;
+    }
+
+    void updateSource(int noteID, const glm::vec3& pos, double time)
+    {
+        addEvent({noteID, -1, pos, time});
+    }
+
+    void addEvent(const SoundEvent& event)
+    {
+        // Only a limited number of producers can exist, without one nothing can be played
+        if (mEventProducer == nullptr)
+            return;
+
+        mEventProducer->addSoundEvent(event);
+
+        // If the GUI falls behind it just misses some events
+        mVisualEvents.push(event);
+    }
+
+    int getSoundIndexFromClipAddress(const String& address) const
+    {
+        return mAddressIndex.get() != nullptr ? mAddressIndex->getClipIndex(address) : -1;
+    }
+
+    // Converts an OSC time tag to Time::getMillisecondCounterHiRes() time
+    double getEventTime(const OSCTimeTag& timeTag)
+    {
+        // The wall clock only has millisecond resolution, so the measured offset to the
+        // hi-res counter is up to 1ms too small. Keeping the largest one avoids adding
+        // that as jitter, unless the wall clock has been changed.
+        const double offset = (double)Time::currentTimeMillis() - Time::getMillisecondCounterHiRes();
+
+        if (std::abs(offset - mWallClockOffsetMs) > 50.0)
+            mWallClockOffsetMs = offset;
+        else
+            mWallClockOffsetMs = jmax(mWallClockOffsetMs, offset);
+
+        // OSC time tags are NTP times, seconds since 1900 in 32.32 fixed point
+        const uint64 rawTimeTag = timeTag.getRawTimeTag();
+        const double secondsSince1900 = (double)(rawTimeTag >> 32) + (double)(rawTimeTag & 0xffffffff) / 4294967296.0;
+        const double secondsFrom1900To1970 = 2208988800.0;
+
+        return (secondsSince1900 - secondsFrom1900To1970) * 1000.0 - mWallClockOffsetMs;
+    }
+
+    //==============================================================================
+    using Handler = bool (OSCEventListener::*)(const OSCMessage&, double);
+
+    /** An address we respond to, parsed once up front. */
+    struct Route
+    {
+        Route(const char* addressToMatch, Handler handlerToUse)
+            : address(addressToMatch),
+              handler(handlerToUse)
+        {
+        }
+
+        OSCAddress  address;
+        Handler     handler;
+    };
+
+    const std::vector<Route>        mRoutes
+    {
+        { "/start",         &OSCEventListener::handleStart },
+        { "/update",        &OSCEventListener::handleUpdate },
+        { "/atmosphere",    &OSCEventListener::handleAtmosphere }
+    };
+
+    OSCReceiver&                    mReceiver;
+    std::unique_ptr<SoundEventData::Producer> mEventProducer;
+
+    std::atomic<uint32>             mNumMessagesReceived { 0 };
+    std::atomic<uint32>             mNumMessagesUnhandled { 0 };
+    std::atomic<uint32>             mNumMessagesMalformed { 0 };
+
+    // Message thread only
+    uint32                          mLastNumMessagesReceived = 0;
+    double                          mLastRateTime = 0.0;
+    float                           mMessagesPerSecond = 0.0f;
+
+    // Only used on the OSC receive thread
+    double                          mWallClockOffsetMs = 0.0;
+
+    // Published by the message thread when new sounds load, and swapped in by the OSC
+    // thread before each packet, so looking up an address never takes a lock
+    RealtimeSnapshot<SoundAddressIndex> mAddressIndex;
+
+    LockFreeFifo<SoundEvent>        mVisualEvents { 2048 };
+    LockFreeFifo<AtmosphereLevel>   mAtmosphereLevels { 256 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OSCEventListener)
+};
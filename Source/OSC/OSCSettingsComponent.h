@@ -13,17 +13,20 @@
 #include <JuceHeader.h>
 #include "juce_osc/juce_osc.h"
 #include "OSCListBox.h"
+#include "../State/AudioMonitorState.h"
 
 
 //==============================================================================
 class OSCSettingsComponent   : public Component,
                                private Label::Listener,
-                               private OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>
+                               private OSCReceiver::Listener<OSCReceiver::MessageLoopCallback>,
+                               private Timer
 {
 public:
     //==============================================================================
-    OSCSettingsComponent(OSCReceiver& reciever)
-        : mOscReceiver(reciever)
+    OSCSettingsComponent(OSCReceiver& reciever, const AudioMonitorState& monitorState)
+        : mOscReceiver(reciever),
+          mMonitorState(monitorState)
     {
         mPortNumberLabel.setJustificationType(Justification::centredRight);
         addAndMakeVisible(mPortNumberLabel);
@@ -45,6 +48,12 @@ public:
         addAndMakeVisible(mOscLogListBox);
 //        addAndMakeVisible(mDemoSender);
 
+        mEventQueueLabel.setFont(Font(13.0f));
+        mEventQueueLabel.setColour(Label::textColourId, Colour::greyLevel(0.6f));
+        mEventQueueLabel.setJustificationType(Justification::centredLeft);
+        addAndMakeVisible(mEventQueueLabel);
+        startTimer(250);
+
         mOscReceiver.addListener(this);
         mOscReceiver.registerFormatErrorHandler([this] (const char* data, int dataSize)
         {
@@ -79,6 +88,7 @@ public:
         mConnectButton.setBounds(topBar.removeFromRight(110).reduced(5, 0));
         
         b.removeFromLeft((int)leftLabelWidth);
+        mEventQueueLabel.setBounds(b.removeFromBottom(20));
         mOscLogListBox.setBounds(b);
 
     }
@@ -90,10 +100,13 @@ private:
     TextButton      mConnectButton      { "Connect" };
     TextButton      mClearButton        { "Clear" };
     Label           mConnectionStatusLabel;
+    Label           mEventQueueLabel;
 
     OSCReceiver&    mOscReceiver;
     OSCLogListBox   mOscLogListBox;
 
+    const AudioMonitorState& mMonitorState;
+
     int             mCurrentPortNumber = -1;
 
     //==============================================================================
@@ -212,6 +225,26 @@ private:
         return port > 0 && port < 65536;
     }
 
+    //==============================================================================
+    void timerCallback() override
+    {
+        updateEventQueueLabel();
+    }
+
+    void updateEventQueueLabel()
+    {
+        const auto& stats = mMonitorState.getEventQueueStatistics();
+
+        String text;
+        text << "Event queue peak " << stats.highWaterMark << " / " << stats.capacity
+             << ",  dropped " << (int)stats.numDroppedUpdates << " updates, " << (int)stats.numDroppedStarts << " starts";
+
+        const bool hasDropped = stats.numDroppedUpdates > 0 || stats.numDroppedStarts > 0;
+
+        mEventQueueLabel.setText(text, dontSendNotification);
+        mEventQueueLabel.setColour(Label::textColourId, hasDropped ? Colours::orange : Colour::greyLevel(0.6f));
+    }
+
     //==============================================================================
     void updateConnectionStatusLabel()
     {
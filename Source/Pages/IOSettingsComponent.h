@@ -72,7 +72,7 @@ public:
                                                                false,
                                                                false));
         
-        mOSCSettings.reset(new OSCSettingsComponent(m.mOSCReciever));
+        mOSCSettings.reset(new OSCSettingsComponent(m.mOSCReciever, m.mAudioMonitorState));
 
         mAudioSettingsContainer.reset(new LabelledSettingsContainer("Audio Settings", mAudioSettings.get()));
         mOSCSettingsContainer.reset(new LabelledSettingsContainer("OSC Settings", mOSCSettings.get()));
@@ -17,6 +17,7 @@
 #include "AudioDataState.h"
 #include "AtmosphereLevelState.h"
 #include "VisualPlayingVoicesState.h"
+#include "AudioEngineSettingsState.h"
 
 
 struct AppModel
@@ -35,6 +36,7 @@ public:
     AudioDataState                      mAudioDataState;
     AtmosphereLevelState                mAtmosphereLevelState;
     VisualPlayingVoicesState            mVisualVoiceState;
+    AudioEngineSettingsState            mAudioEngineSettingsState;
     
     // Used by the mouse interface
     int                                 mCurrentMouseNoteID = -99999;
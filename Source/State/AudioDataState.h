@@ -25,6 +25,25 @@ struct SoundFileData
         generateWaveform(data);
     }
 
+    SoundFileData(const String& name, const std::vector<float>& waveform, double fileLength, int index)
+        : mName(name),
+          mFileLength(fileLength),
+          mIndex(index),
+          mWaveform(waveform)
+    {
+        mOSCAddress = mName.replace(" ", "_");
+    }
+
+    SoundFileData(const String& name, AudioFormatReader& reader, double fileLength, int index)
+        : mName(name),
+          mFileLength(fileLength),
+          mIndex(index)
+    {
+        mOSCAddress = mName.replace(" ", "_");
+
+        generateWaveform(reader);
+    }
+
     void generateWaveform(const AudioBuffer<float>& data)
     {
         const int numSamples = data.getNumSamples();
@@ -49,6 +68,39 @@ struct SoundFileData
             l = jmin(l / maxLevel, 1.0f);
     }
 
+    // For files that are too long to load, only the start of each window is read
+    void generateWaveform(AudioFormatReader& reader)
+    {
+        const int64 numSamples = reader.lengthInSamples;
+        const int64 step = numSamples / mWaveformSize;
+        const int windowSize = (int)jlimit((int64)1, (int64)mMaxReadWindowSize, step * 2);
+        const int numChannels = (int)reader.numChannels;
+
+        AudioBuffer<float> window(numChannels, windowSize);
+        float maxLevel = 0.01f;
+
+        for (int i = 0; i < mWaveformSize; ++i)
+        {
+            const int64 startSample = i * step;
+            const int numWindowSamples = (int)jmin((int64)windowSize, numSamples - startSample - 1);
+            float level = 0.0f;
+
+            if (numWindowSamples > 0)
+            {
+                reader.read(&window, 0, numWindowSamples, startSample, true, true);
+                level = window.getRMSLevel(numChannels - 1, 0, numWindowSamples);
+            }
+
+            mWaveform.push_back(level);
+
+            if (level > maxLevel)
+                maxLevel = level;
+        }
+
+        for (auto& l : mWaveform)
+            l = jmin(l / maxLevel, 1.0f);
+    }
+
     String                              mName;
     String                              mOSCAddress;
     double                              mFileLength;
@@ -56,6 +108,56 @@ struct SoundFileData
 
     std::vector<float>                  mWaveform;
     int                                 mWaveformSize = 256;
+    int                                 mMaxReadWindowSize = 16384;
+};
+
+
+/** Maps the OSC addresses of the clips and atmospheres to their indices.
+    It is never changed after it is built, so any thread can read it.
+*/
+class SoundAddressIndex
+{
+public:
+    SoundAddressIndex(const std::vector<SoundFileData>& clips, const std::vector<SoundFileData>& atmospheres)
+        : mClipIndices(getNumSlotsFor(clips.size())),
+          mAtmosphereIndices(getNumSlotsFor(atmospheres.size())),
+          mNumClips((int)clips.size()),
+          mNumAtmospheres((int)atmospheres.size())
+    {
+        addAddresses(mClipIndices, clips);
+        addAddresses(mAtmosphereIndices, atmospheres);
+    }
+
+    int getClipIndex(const String& address) const           { return findIndex(mClipIndices, address); }
+    int getAtmosphereIndex(const String& address) const     { return findIndex(mAtmosphereIndices, address); }
+
+    int getNumClips() const noexcept                        { return mNumClips; }
+    int getNumAtmospheres() const noexcept                  { return mNumAtmospheres; }
+
+private:
+    using IndexMap = HashMap<String, int>;
+
+    static int getNumSlotsFor(size_t numItems)              { return jmax(101, (int)numItems * 2 + 1); }
+
+    static void addAddresses(IndexMap& indices, const std::vector<SoundFileData>& data)
+    {
+        // If two files have the same address the first one is used
+        for (int i = 0; i < (int)data.size(); ++i)
+            if (! indices.contains(data[(size_t)i].mOSCAddress))
+                indices.set(data[(size_t)i].mOSCAddress, i);
+    }
+
+    static int findIndex(const IndexMap& indices, const String& address)
+    {
+        return indices.contains(address) ? indices[address] : -1;
+    }
+
+    IndexMap    mClipIndices;
+    IndexMap    mAtmosphereIndices;
+    int         mNumClips;
+    int         mNumAtmospheres;
+
+    JUCE_DECLARE_NON_COPYABLE (SoundAddressIndex)
 };
 
 
@@ -76,25 +178,6 @@ public:
     {
         mSoundClipData.emplace_back(name, data, fileLength, (int)mSoundClipData.size());
     }
-    
-    
-    int getAtmosphereIndexFromClipAddress(const String& address)
-    {
-        for (int i = 0; i < mSoundClipData.size(); ++i)
-            if (mSoundClipData[i].mOSCAddress == address)
-                return i;
-                
-        return -1;
-    }
-    
-    int getSoundIndexFromClipAddress(const String& address)
-    {
-        for (int i = 0; i < mSoundClipData.size(); ++i)
-            if (mSoundClipData[i].mOSCAddress == address)
-                return i;
-                
-        return -1;
-    }
 
     File                                mCurrentSoundAtmosphereFolder;
     std::vector<SoundFileData>          mSoundAtmosphereData;
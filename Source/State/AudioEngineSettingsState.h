@@ -0,0 +1,194 @@
+/*
+  ==============================================================================
+
+    AudioEngineSettingsState.h
+    Created: 17 Oct 2026 3:02:51pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../Audio/SoundEventData.h"
+#include "../Audio/SpatialSynth.h"
+
+/** This class holds the performance related settings of the audio engine
+    and sends change messages when they are edited.
+*/
+class AudioEngineSettingsState : public ChangeBroadcaster
+{
+public:
+    AudioEngineSettingsState()
+    {
+    }
+
+    void setNumRenderThreads(int numThreads)
+    {
+        numThreads = jlimit(0, getMaxRenderThreads(), numThreads);
+
+        if (numThreads == mNumRenderThreads)
+            return;
+
+        mNumRenderThreads = numThreads;
+        sendChangeMessage();
+    }
+
+    int         getNumRenderThreads() const     { return mNumRenderThreads; }
+
+    /** The size of the voice pool, which limits how many clips can play at once. */
+    void setNumVoices(int numVoices)
+    {
+        numVoices = jlimit(1, maxNumVoices, numVoices);
+
+        if (numVoices == mNumVoices)
+            return;
+
+        mNumVoices = numVoices;
+        sendChangeMessage();
+    }
+
+    int         getNumVoices() const            { return mNumVoices; }
+
+    /** How many sound events from each source can be waiting to be played. This only
+        takes effect when the app is restarted.
+    */
+    void setEventQueueCapacity(int capacity)
+    {
+        capacity = jlimit(SoundEventData::minCapacity, SoundEventData::maxCapacity, capacity);
+
+        if (capacity == mEventQueueCapacity)
+            return;
+
+        mEventQueueCapacity = capacity;
+        sendChangeMessage();
+    }
+
+    int         getEventQueueCapacity() const   { return mEventQueueCapacity; }
+
+    /** The number of points along each axis of the precomputed DBAP gain grid, or 0 to
+        calculate the gains exactly. Finer grids are more accurate but use more memory.
+    */
+    void setDBAPGridResolution(int resolution)
+    {
+        resolution = jlimit(0, maxDBAPGridResolution, resolution);
+
+        if (resolution == mDBAPGridResolution)
+            return;
+
+        mDBAPGridResolution = resolution;
+        sendChangeMessage();
+    }
+
+    int         getDBAPGridResolution() const   { return mDBAPGridResolution; }
+
+    /** Speakers where a voice's DBAP gain is below this level aren't mixed into. */
+    void setDBAPCullThresholdDb(float thresholdDb)
+    {
+        thresholdDb = jlimit(minDBAPCullThresholdDb, 0.0f, thresholdDb);
+
+        if (thresholdDb == mDBAPCullThresholdDb)
+            return;
+
+        mDBAPCullThresholdDb = thresholdDb;
+        sendChangeMessage();
+    }
+
+    float       getDBAPCullThresholdDb() const  { return mDBAPCullThresholdDb; }
+
+    /** The most speakers a voice is mixed into, or 0 for no limit. */
+    void setDBAPMaxSpeakersPerVoice(int maxSpeakers)
+    {
+        maxSpeakers = jmax(0, maxSpeakers);
+
+        if (maxSpeakers == mDBAPMaxSpeakersPerVoice)
+            return;
+
+        mDBAPMaxSpeakersPerVoice = maxSpeakers;
+        sendChangeMessage();
+    }
+
+    int         getDBAPMaxSpeakersPerVoice() const  { return mDBAPMaxSpeakersPerVoice; }
+
+    /** How the voices are spread over the speakers. */
+    void setPanningMode(SpatialSynth::PanningMode mode)
+    {
+        if (mode == mPanningMode)
+            return;
+
+        mPanningMode = mode;
+        sendChangeMessage();
+    }
+
+    SpatialSynth::PanningMode getPanningMode() const    { return mPanningMode; }
+
+    /** The order of the Ambisonic bus used by the Ambisonics panning mode. */
+    void setAmbisonicOrder(int order)
+    {
+        order = jlimit(1, maxAmbisonicOrder, order);
+
+        if (order == mAmbisonicOrder)
+            return;
+
+        mAmbisonicOrder = order;
+        sendChangeMessage();
+    }
+
+    int         getAmbisonicOrder() const       { return mAmbisonicOrder; }
+
+    /** Atmospheres that would decode to more than this many megabytes are streamed
+        from disk instead of being loaded into memory. 0 loads everything.
+    */
+    void setAtmosphereStreamingThresholdMB(int thresholdMB)
+    {
+        thresholdMB = jmax(0, thresholdMB);
+
+        if (thresholdMB == mAtmosphereStreamingThresholdMB)
+            return;
+
+        mAtmosphereStreamingThresholdMB = thresholdMB;
+        sendChangeMessage();
+    }
+
+    int         getAtmosphereStreamingThresholdMB() const   { return mAtmosphereStreamingThresholdMB; }
+    int64       getAtmosphereStreamingThresholdBytes() const { return (int64)mAtmosphereStreamingThresholdMB * 1024 * 1024; }
+
+    /** If enabled the clips are cached as mono sample data in a memory mapped file,
+        which loads much faster and can be shared between processes.
+    */
+    void setUseClipCache(bool shouldUseCache)
+    {
+        if (shouldUseCache == mUseClipCache)
+            return;
+
+        mUseClipCache = shouldUseCache;
+        sendChangeMessage();
+    }
+
+    bool        getUseClipCache() const         { return mUseClipCache; }
+
+    // Leave a core free for the message thread
+    static int  getMaxRenderThreads()           { return jmax(0, SystemStats::getNumCpus() - 2); }
+
+    static constexpr int maxNumVoices = 4096;
+    static constexpr int maxDBAPGridResolution = 64;
+    static constexpr float minDBAPCullThresholdDb = -120.0f;
+    static constexpr int maxAmbisonicOrder = 5;
+
+private:
+
+    int         mNumRenderThreads = 0;
+    int         mNumVoices = 128;
+    int         mEventQueueCapacity = SoundEventData::defaultCapacity;
+    int         mDBAPGridResolution = 0;
+    float       mDBAPCullThresholdDb = -60.0f;
+    int         mDBAPMaxSpeakersPerVoice = 0;
+    SpatialSynth::PanningMode mPanningMode = SpatialSynth::PanningMode::dbap;
+    int         mAmbisonicOrder = 3;
+    int         mAtmosphereStreamingThresholdMB = 256;
+    bool        mUseClipCache = true;
+
+    friend class AppModelLoader;
+
+};
@@ -11,6 +11,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "../Audio/SoundEventData.h"
 
 class AudioMonitorState : public ChangeBroadcaster
 {
@@ -38,8 +39,14 @@ public:
 
     const std::vector<float>&  getAudioLevels() const { return mAudioLevels; }
 
+    // Updated along with the levels, but doesn't send a change message of its own
+    void setEventQueueStatistics(const SoundEventData::Statistics& stats) { mEventQueueStatistics = stats; }
+
+    const SoundEventData::Statistics& getEventQueueStatistics() const   { return mEventQueueStatistics; }
+
 private:
 
     std::vector<float>                  mAudioLevels;
+    SoundEventData::Statistics          mEventQueueStatistics;
 
 };
\ No newline at end of file
@@ -15,6 +15,16 @@ const String AppModelLoader::mCurrentSoundClipFolderID = "audio-clip-files-locat
 const String AppModelLoader::mCurrentSoundAtmosphereFolderID = "audio-atmosphere-files-location";
 const String AppModelLoader::mSpeakerInfoID = "speaker-info";
 const String AppModelLoader::mAudioDeviceInfoID = "audio-device-info";
+const String AppModelLoader::mNumRenderThreadsID = "audio-render-threads";
+const String AppModelLoader::mNumVoicesID = "audio-num-voices";
+const String AppModelLoader::mEventQueueCapacityID = "audio-event-queue-capacity";
+const String AppModelLoader::mDBAPGridResolutionID = "audio-dbap-grid-resolution";
+const String AppModelLoader::mDBAPCullThresholdID = "audio-dbap-cull-threshold-db";
+const String AppModelLoader::mDBAPMaxSpeakersPerVoiceID = "audio-dbap-max-speakers-per-voice";
+const String AppModelLoader::mPanningModeID = "audio-panning-mode";
+const String AppModelLoader::mAmbisonicOrderID = "audio-ambisonic-order";
+const String AppModelLoader::mAtmosphereStreamingThresholdID = "audio-atmosphere-streaming-threshold-mb";
+const String AppModelLoader::mUseClipCacheID = "audio-clip-cache";
 
 void AppModelLoader::loadSettings(AppModel& m)
 {
@@ -76,6 +86,30 @@ void AppModelLoader::loadSettings(AppModel& m)
     }
     
     m.mSpeakerPositionsState.sendChangeMessage();
+
+    // Init audio engine settings
+    
+    auto& engineSettings = m.mAudioEngineSettingsState;
+    engineSettings.mNumRenderThreads = jlimit(0, AudioEngineSettingsState::getMaxRenderThreads(),
+                                              m.mSettingsFile->getIntValue(mNumRenderThreadsID, 0));
+    engineSettings.mNumVoices = jlimit(1, AudioEngineSettingsState::maxNumVoices,
+                                       m.mSettingsFile->getIntValue(mNumVoicesID, engineSettings.mNumVoices));
+    engineSettings.mEventQueueCapacity = jlimit(SoundEventData::minCapacity, SoundEventData::maxCapacity,
+                                                m.mSettingsFile->getIntValue(mEventQueueCapacityID, engineSettings.mEventQueueCapacity));
+    engineSettings.mDBAPGridResolution = jlimit(0, AudioEngineSettingsState::maxDBAPGridResolution,
+                                                m.mSettingsFile->getIntValue(mDBAPGridResolutionID, engineSettings.mDBAPGridResolution));
+    engineSettings.mDBAPCullThresholdDb = jlimit(AudioEngineSettingsState::minDBAPCullThresholdDb, 0.0f,
+                                                 (float)m.mSettingsFile->getDoubleValue(mDBAPCullThresholdID, engineSettings.mDBAPCullThresholdDb));
+    engineSettings.mDBAPMaxSpeakersPerVoice = jmax(0, m.mSettingsFile->getIntValue(mDBAPMaxSpeakersPerVoiceID, engineSettings.mDBAPMaxSpeakersPerVoice));
+    engineSettings.mPanningMode = getPanningModeFromName(m.mSettingsFile->getValue(mPanningModeID,
+                                                                                   getPanningModeName(engineSettings.mPanningMode)));
+    engineSettings.mAmbisonicOrder = jlimit(1, AudioEngineSettingsState::maxAmbisonicOrder,
+                                            m.mSettingsFile->getIntValue(mAmbisonicOrderID, engineSettings.mAmbisonicOrder));
+    engineSettings.mAtmosphereStreamingThresholdMB = jmax(0, m.mSettingsFile->getIntValue(mAtmosphereStreamingThresholdID,
+                                                                                           engineSettings.mAtmosphereStreamingThresholdMB));
+    engineSettings.mUseClipCache = m.mSettingsFile->getBoolValue(mUseClipCacheID, engineSettings.mUseClipCache);
+    
+    engineSettings.sendChangeMessage();
 }
 
 void AppModelLoader::saveSettings(AppModel& m)
@@ -102,5 +136,35 @@ void AppModelLoader::saveSettings(AppModel& m)
         m.mSettingsFile->setValue(mAudioDeviceInfoID, audioDeviceProps.get());
         
     m.mSettingsFile->setValue(mSpeakerInfoID, &speakersProps);
+    m.mSettingsFile->setValue(mNumRenderThreadsID, m.mAudioEngineSettingsState.getNumRenderThreads());
+    m.mSettingsFile->setValue(mNumVoicesID, m.mAudioEngineSettingsState.getNumVoices());
+    m.mSettingsFile->setValue(mEventQueueCapacityID, m.mAudioEngineSettingsState.getEventQueueCapacity());
+    m.mSettingsFile->setValue(mDBAPGridResolutionID, m.mAudioEngineSettingsState.getDBAPGridResolution());
+    m.mSettingsFile->setValue(mDBAPCullThresholdID, m.mAudioEngineSettingsState.getDBAPCullThresholdDb());
+    m.mSettingsFile->setValue(mDBAPMaxSpeakersPerVoiceID, m.mAudioEngineSettingsState.getDBAPMaxSpeakersPerVoice());
+    m.mSettingsFile->setValue(mPanningModeID, getPanningModeName(m.mAudioEngineSettingsState.getPanningMode()));
+    m.mSettingsFile->setValue(mAmbisonicOrderID, m.mAudioEngineSettingsState.getAmbisonicOrder());
+    m.mSettingsFile->setValue(mAtmosphereStreamingThresholdID, m.mAudioEngineSettingsState.getAtmosphereStreamingThresholdMB());
+    m.mSettingsFile->setValue(mUseClipCacheID, m.mAudioEngineSettingsState.getUseClipCache());
     m.mSettingsFile->save();
 }
+
+String AppModelLoader::getPanningModeName(SpatialSynth::PanningMode mode)
+{
+    switch (mode)
+    {
+        case SpatialSynth::PanningMode::vbap:       return "vbap";
+        case SpatialSynth::PanningMode::ambisonics: return "ambisonics";
+        case SpatialSynth::PanningMode::dbap:       break;
+    }
+
+    return "dbap";
+}
+
+SpatialSynth::PanningMode AppModelLoader::getPanningModeFromName(const String& name)
+{
+    if (name == "vbap")         return SpatialSynth::PanningMode::vbap;
+    if (name == "ambisonics")   return SpatialSynth::PanningMode::ambisonics;
+
+    return SpatialSynth::PanningMode::dbap;
+}
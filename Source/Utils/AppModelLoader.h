@@ -23,5 +23,19 @@ public:
     static const String   mCurrentSoundAtmosphereFolderID;
     static const String   mSpeakerInfoID;
     static const String   mAudioDeviceInfoID;
+    static const String   mNumRenderThreadsID;
+    static const String   mNumVoicesID;
+    static const String   mEventQueueCapacityID;
+    static const String   mDBAPGridResolutionID;
+    static const String   mDBAPCullThresholdID;
+    static const String   mDBAPMaxSpeakersPerVoiceID;
+    static const String   mPanningModeID;
+    static const String   mAmbisonicOrderID;
+    static const String   mAtmosphereStreamingThresholdID;
+    static const String   mUseClipCacheID;
+
+private:
+    static String getPanningModeName(SpatialSynth::PanningMode mode);
+    static SpatialSynth::PanningMode getPanningModeFromName(const String& name);
 
 };
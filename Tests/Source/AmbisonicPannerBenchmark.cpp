@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    AmbisonicPannerBenchmark.cpp
+    Created: 17 Oct 2026 7:24:36pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/Audio/AmbisonicPanner.h"
+#include "../../Source/Audio/SpatialSynthVoice.h"
+
+//==============================================================================
+/**
+    Compares how long a block of moving voices takes to pan with DBAP and through
+    an Ambisonic bus, for each order on a few sizes of layout.
+*/
+class AmbisonicPannerBenchmark  : public UnitTest
+{
+public:
+    AmbisonicPannerBenchmark() : UnitTest("AmbisonicPanner cost", "Benchmarks") {}
+
+    void runTest() override
+    {
+        const int numVoices = 128;
+        const int blockSize = 512;
+
+        for (int numSpeakers : { 8, 32, 128 })
+        {
+            beginTest(String(numVoices) + " voices, " + String(numSpeakers) + " speakers, "
+                      + String(blockSize) + " sample blocks");
+
+            const auto speakerPositions = createSpeakerPositions(numSpeakers);
+            const double dbapMicroseconds = measureDBAPCost(speakerPositions, numVoices, blockSize);
+
+            String message;
+            message << "DBAP " << String(dbapMicroseconds, 1) << "us";
+
+            for (int order = AmbisonicPanner::minOrder; order <= AmbisonicPanner::maxOrder; ++order)
+            {
+                AmbisonicPanner panner(speakerPositions, order, blockSize);
+                const double ambisonicMicroseconds = measureAmbisonicCost(panner, speakerPositions, numVoices, blockSize);
+                expect(ambisonicMicroseconds > 0.0);
+
+                message << ", order " << order << " (" << panner.getNumChannels() << " channels) "
+                        << String(ambisonicMicroseconds, 1) << "us";
+            }
+
+            logMessage(message);
+        }
+    }
+
+private:
+    static std::vector<glm::vec3> createSpeakerPositions(int numSpeakers)
+    {
+        // A fixed seed so that the same layout always gives the same result
+        Random random(4321);
+        std::vector<glm::vec3> positions((size_t)numSpeakers);
+
+        for (auto& p : positions)
+            p = glm::vec3(random.nextFloat(), random.nextFloat(), random.nextFloat()) * 10.0f;
+
+        return positions;
+    }
+
+    static std::vector<glm::vec3> createVoicePositions(int numVoices)
+    {
+        Random random(1234);
+        std::vector<glm::vec3> positions((size_t)numVoices);
+
+        for (auto& p : positions)
+            p = glm::vec3(random.nextFloat(), random.nextFloat(), random.nextFloat()) * 10.0f;
+
+        return positions;
+    }
+
+    static AudioBuffer<float> createSource(int blockSize)
+    {
+        Random random(5678);
+        AudioBuffer<float> source(1, blockSize);
+
+        for (int i = 0; i < blockSize; ++i)
+            source.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+
+        return source;
+    }
+
+    /** Microseconds to calculate the gains of every voice and mix it into every speaker. */
+    static double measureDBAPCost(const std::vector<glm::vec3>& speakerPositions, int numVoices, int blockSize)
+    {
+        const int numSpeakers = (int)speakerPositions.size();
+        const auto positions = createVoicePositions(numVoices);
+        const auto source = createSource(blockSize);
+
+        AudioBuffer<float> speakers(numSpeakers, blockSize);
+        std::vector<float> gains((size_t)numSpeakers);
+        speakers.clear();
+
+        const int64 startTime = Time::getHighResolutionTicks();
+
+        for (const auto& p : positions)
+        {
+            SpatialSynthVoice::calculateDBAPGains(speakerPositions, p, gains.data(), numSpeakers);
+
+            for (int s = 0; s < numSpeakers; ++s)
+                FloatVectorOperations::addWithMultiply(speakers.getWritePointer(s), source.getReadPointer(0),
+                                                       gains[(size_t)s], blockSize);
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTime) * 1.0e6;
+    }
+
+    /** Microseconds to encode every voice into the bus and decode the bus once. */
+    static double measureAmbisonicCost(AmbisonicPanner& panner, const std::vector<glm::vec3>& speakerPositions,
+                                       int numVoices, int blockSize)
+    {
+        const int numChannels = panner.getNumChannels();
+        const auto positions = createVoicePositions(numVoices);
+        const auto source = createSource(blockSize);
+
+        AudioBuffer<float> speakers((int)speakerPositions.size(), blockSize);
+        std::vector<float> gains((size_t)numChannels);
+        auto& bus = panner.getBus();
+        speakers.clear();
+
+        const int64 startTime = Time::getHighResolutionTicks();
+
+        bus.clear();
+
+        for (const auto& p : positions)
+        {
+            panner.getEncodingGains(p, gains.data());
+
+            for (int k = 0; k < numChannels; ++k)
+                FloatVectorOperations::addWithMultiply(bus.getWritePointer(k), source.getReadPointer(0),
+                                                       gains[(size_t)k], blockSize);
+        }
+
+        panner.decode(blockSize, speakers, 0);
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTime) * 1.0e6;
+    }
+};
+
+static AmbisonicPannerBenchmark ambisonicPannerBenchmark;
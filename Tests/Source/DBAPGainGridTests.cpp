@@ -0,0 +1,197 @@
+/*
+  ==============================================================================
+
+    DBAPGainGridTests.cpp
+    Created: 17 Oct 2026 7:08:51pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/Audio/DBAPGainGrid.h"
+#include "../../Source/Audio/SpatialSynthVoice.h"
+
+namespace
+{
+    std::vector<glm::vec3> createSpeakerPositions(int numSpeakers)
+    {
+        // A fixed seed so that the same layout always gives the same result
+        Random random(4321);
+        std::vector<glm::vec3> positions((size_t)numSpeakers);
+
+        for (auto& p : positions)
+            p = glm::vec3(random.nextFloat(), random.nextFloat(), random.nextFloat()) * 10.0f;
+
+        return positions;
+    }
+
+    /** Random positions within the speakers' bounding box, which the grid always covers. */
+    std::vector<glm::vec3> createSourcePositions(const std::vector<glm::vec3>& speakerPositions, int numPositions)
+    {
+        Random random(1234);
+        glm::vec3 min = speakerPositions[0];
+        glm::vec3 max = speakerPositions[0];
+
+        for (const auto& p : speakerPositions)
+        {
+            min = glm::vec3(jmin(min.x, p.x), jmin(min.y, p.y), jmin(min.z, p.z));
+            max = glm::vec3(jmax(max.x, p.x), jmax(max.y, p.y), jmax(max.z, p.z));
+        }
+
+        std::vector<glm::vec3> positions((size_t)numPositions);
+
+        for (auto& p : positions)
+            p = min + (max - min) * glm::vec3(random.nextFloat(), random.nextFloat(), random.nextFloat());
+
+        return positions;
+    }
+
+    /** How closely a grid matches the exact gains at the given positions. */
+    struct GridError
+    {
+        float   maxGainError = 0.0f;
+        float   meanGainError = 0.0f;
+    };
+
+    GridError measureError(const DBAPGainGrid& grid,
+                           const std::vector<glm::vec3>& speakerPositions,
+                           const std::vector<glm::vec3>& sourcePositions)
+    {
+        const int numSpeakers = (int)speakerPositions.size();
+        std::vector<float> exactGains((size_t)numSpeakers);
+        std::vector<float> gridGains((size_t)numSpeakers);
+
+        GridError error;
+        double sumError = 0.0;
+
+        for (const auto& position : sourcePositions)
+        {
+            SpatialSynthVoice::calculateDBAPGains(speakerPositions, position, exactGains.data(), numSpeakers);
+
+            if (! grid.getGains(position, gridGains.data(), numSpeakers))
+                return { 1.0f, 1.0f };
+
+            for (int i = 0; i < numSpeakers; ++i)
+            {
+                const float e = std::abs(exactGains[(size_t)i] - gridGains[(size_t)i]);
+                error.maxGainError = jmax(error.maxGainError, e);
+                sumError += e;
+            }
+        }
+
+        error.meanGainError = (float)(sumError / (double)(sourcePositions.size() * (size_t)numSpeakers));
+        return error;
+    }
+}
+
+//==============================================================================
+class DBAPGainGridTests  : public UnitTest
+{
+public:
+    DBAPGainGridTests() : UnitTest("DBAPGainGrid", "Audio") {}
+
+    void runTest() override
+    {
+        const auto speakerPositions = createSpeakerPositions(16);
+        const auto sourcePositions = createSourcePositions(speakerPositions, 1000);
+
+        beginTest("Interpolated gains are close to the exact gains");
+        {
+            auto grid = DBAPGainGrid::build(speakerPositions, 32, nullptr);
+            expect(grid != nullptr);
+
+            if (grid != nullptr)
+                expectLessThan(measureError(*grid, speakerPositions, sourcePositions).meanGainError, 1.0e-3f);
+        }
+
+        beginTest("A finer grid is more accurate");
+        {
+            auto coarse = DBAPGainGrid::build(speakerPositions, 8, nullptr);
+            auto fine = DBAPGainGrid::build(speakerPositions, 32, nullptr);
+
+            if (coarse != nullptr && fine != nullptr)
+                expectLessThan(measureError(*fine, speakerPositions, sourcePositions).meanGainError,
+                               measureError(*coarse, speakerPositions, sourcePositions).meanGainError);
+        }
+
+        beginTest("Positions outside the grid are left to the exact calculation");
+        {
+            auto grid = DBAPGainGrid::build(speakerPositions, 8, nullptr);
+            std::vector<float> gains(speakerPositions.size(), -1.0f);
+
+            expect(! grid->getGains(glm::vec3(100.0f), gains.data(), (int)gains.size()));
+            expectEquals(gains[0], -1.0f);
+        }
+
+        beginTest("A cancelled build returns nothing");
+        {
+            expect(DBAPGainGrid::build(speakerPositions, 32, [] { return true; }) == nullptr);
+        }
+    }
+};
+
+static DBAPGainGridTests dbapGainGridTests;
+
+
+//==============================================================================
+/**
+    Shows how long grids take to build, how much memory they use, how accurate they
+    are and how long a lookup takes compared to calculating the gains exactly.
+*/
+class DBAPGainGridBenchmark  : public UnitTest
+{
+public:
+    DBAPGainGridBenchmark() : UnitTest("DBAPGainGrid cost", "Benchmarks") {}
+
+    void runTest() override
+    {
+        for (int numSpeakers : { 8, 64 })
+        {
+            const auto speakerPositions = createSpeakerPositions(numSpeakers);
+            const auto sourcePositions = createSourcePositions(speakerPositions, 1000);
+
+            for (int resolution : { 16, 32, 64 })
+            {
+                beginTest(String(numSpeakers) + " speakers, resolution " + String(resolution));
+
+                const double startTime = Time::getMillisecondCounterHiRes();
+                auto grid = DBAPGainGrid::build(speakerPositions, resolution, nullptr);
+                const double buildTime = Time::getMillisecondCounterHiRes() - startTime;
+
+                expect(grid != nullptr);
+
+                if (grid == nullptr)
+                    continue;
+
+                const auto error = measureError(*grid, speakerPositions, sourcePositions);
+                std::vector<float> gains((size_t)numSpeakers);
+
+                const int64 exactStart = Time::getHighResolutionTicks();
+
+                for (const auto& position : sourcePositions)
+                    SpatialSynthVoice::calculateDBAPGains(speakerPositions, position, gains.data(), numSpeakers);
+
+                const int64 gridStart = Time::getHighResolutionTicks();
+
+                for (const auto& position : sourcePositions)
+                    grid->getGains(position, gains.data(), numSpeakers);
+
+                const int64 gridEnd = Time::getHighResolutionTicks();
+
+                const double numPositions = (double)sourcePositions.size();
+                const double exactMicroseconds = Time::highResolutionTicksToSeconds(gridStart - exactStart) * 1.0e6 / numPositions;
+                const double gridMicroseconds = Time::highResolutionTicksToSeconds(gridEnd - gridStart) * 1.0e6 / numPositions;
+
+                String message;
+                message << grid->getResolution() << "^3 grid built in " << String(buildTime, 1) << "ms ("
+                        << (int)(grid->getMemoryUsage() / 1024) << "KB), max gain error " << String(error.maxGainError, 4)
+                        << ", mean " << String(error.meanGainError, 5) << ", " << String(gridMicroseconds, 2)
+                        << "us per lookup vs " << String(exactMicroseconds, 2) << "us exact";
+                logMessage(message);
+            }
+        }
+    }
+};
+
+static DBAPGainGridBenchmark dbapGainGridBenchmark;
@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 17 Oct 2026 6:12:40pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Runs the tests and benchmarks of the audio engine.
+
+    With no arguments everything is run, otherwise only the categories named on the
+    command line, e.g. "SoundscaperTests Benchmarks". Returns 1 if any test failed.
+*/
+int main(int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+
+    int numFailures = 0;
+
+    const auto countFailures = [&runner, &numFailures]()
+    {
+        for (int i = 0; i < runner.getNumResults(); ++i)
+            numFailures += runner.getResult(i)->failures;
+    };
+
+    if (argc < 2)
+    {
+        runner.runAllTests();
+        countFailures();
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        runner.runTestsInCategory(argv[i]);
+        countFailures();
+    }
+
+    return numFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    SoundEventDataTests.cpp
+    Created: 17 Oct 2026 6:52:15pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/Audio/SoundEventData.h"
+
+//==============================================================================
+class SoundEventDataTests  : public UnitTest
+{
+public:
+    SoundEventDataTests() : UnitTest("SoundEventData", "Audio") {}
+
+    void runTest() override
+    {
+        beginTest("Events from every producer arrive once and in order");
+        {
+            const int numEventsPerProducer = 10000;
+
+            // A small queue, so the producers keep finding their fifo full
+            SoundEventData data(SoundEventData::minCapacity * 4);
+            data.prepareToPlay(48000.0, 64);
+
+            // Deleted before the data, as producers must be
+            OwnedArray<ProducerThread> producers;
+
+            for (int i = 0; i < SoundEventData::maxNumProducers; ++i)
+                producers.add(new ProducerThread(data, i, numEventsPerProducer));
+
+            std::vector<int> nextIndices((size_t)SoundEventData::maxNumProducers, 0);
+            const int numExpected = SoundEventData::maxNumProducers * numEventsPerProducer;
+            const double startTime = Time::getMillisecondCounterHiRes();
+            int numReceived = 0;
+            int numOutOfOrder = 0;
+
+            for (auto* producer : producers)
+                producer->startThread();
+
+            // Gives up after a few seconds rather than hanging if events go missing
+            while (numReceived < numExpected && Time::getMillisecondCounterHiRes() - startTime < 5000.0)
+            {
+                for (const auto& event : data.getEventsForNextBlock(64))
+                {
+                    auto& nextIndex = nextIndices[(size_t)event.soundID];
+                    const int index = (int)event.position.x;
+
+                    if (index != nextIndex)
+                        ++numOutOfOrder;
+
+                    nextIndex = index + 1;
+                    ++numReceived;
+                }
+            }
+
+            const double milliseconds = Time::getMillisecondCounterHiRes() - startTime;
+            int numSent = 0;
+            int numFullFifoRetries = 0;
+
+            for (auto* producer : producers)
+            {
+                producer->stopThread(1000);
+                numSent += producer->numSent;
+                numFullFifoRetries += producer->numFullFifoRetries;
+            }
+
+            expectEquals(numSent, numExpected);
+            expectEquals(numReceived, numSent);
+            expectEquals(numOutOfOrder, 0);
+
+            logMessage(String(SoundEventData::maxNumProducers) + " producers sent " + String(numSent) + " events, "
+                       + String(numFullFifoRetries) + " full fifo retries in " + String(milliseconds, 1) + "ms");
+        }
+    }
+
+private:
+    /** Adds numEvents start events as fast as it can, backing off when its fifo is full. */
+    struct ProducerThread  : public Thread
+    {
+        ProducerThread(SoundEventData& data, int index, int numEvents)
+            : Thread("Sound Event Test " + String(index)),
+              producer(data.createProducer()),
+              producerIndex(index),
+              numEventsToSend(numEvents)
+        {
+        }
+
+        void run() override
+        {
+            // The event's index goes in its position so the order can be checked
+            for (int i = 0; i < numEventsToSend && ! threadShouldExit(); ++i)
+            {
+                SoundEvent event;
+                event.noteID = -1;
+                event.soundID = producerIndex;
+                event.position = glm::vec3((float)i, 0.0f, 0.0f);
+
+                // A full fifo fails straight away, so back off and try again
+                while (! producer->addSoundEvent(event))
+                {
+                    if (threadShouldExit())
+                        return;
+
+                    ++numFullFifoRetries;
+                    Thread::yield();
+                }
+
+                ++numSent;
+            }
+        }
+
+        std::unique_ptr<SoundEventData::Producer>   producer;
+        const int                                   producerIndex;
+        const int                                   numEventsToSend;
+        int                                         numSent = 0;
+        int                                         numFullFifoRetries = 0;
+    };
+};
+
+static SoundEventDataTests soundEventDataTests;
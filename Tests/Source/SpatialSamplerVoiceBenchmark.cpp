@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    SpatialSamplerVoiceBenchmark.cpp
+    Created: 17 Oct 2026 6:14:02pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/Audio/SpatialSampler.h"
+
+//==============================================================================
+/**
+    Shows how the cost of a playing clip grows with the number of speakers it's
+    mixed into, for a short and a long block.
+*/
+class SpatialSamplerVoiceBenchmark  : public UnitTest
+{
+public:
+    SpatialSamplerVoiceBenchmark() : UnitTest("SpatialSamplerVoice cost", "Benchmarks") {}
+
+    void runTest() override
+    {
+        for (int blockSize : { 64, 512 })
+        {
+            beginTest("Clip voice cost per " + String(blockSize) + " sample block");
+
+            String message;
+
+            for (int numSpeakers = 2; numSpeakers <= SpatialSynthVoice::maxNumSpeakerOutputs; numSpeakers *= 2)
+            {
+                const double micros = measureCost(numSpeakers, blockSize);
+                expect(micros > 0.0);
+
+                message << numSpeakers << " speakers " << String(micros, 2) << "us"
+                        << (numSpeakers < SpatialSynthVoice::maxNumSpeakerOutputs ? ", " : "");
+            }
+
+            logMessage(message);
+        }
+    }
+
+private:
+    /** Times one voice that isn't moving rendering into numSpeakers speakers, in
+        microseconds per block of blockSize samples.
+    */
+    static double measureCost(int numSpeakers, int blockSize)
+    {
+        const int numBlocks = 32;
+        const double sampleRate = 44100.0;
+
+        // A fixed seed so that the same arguments always time the same work
+        Random random(1234);
+        std::vector<glm::vec3> speakerPositions((size_t)numSpeakers);
+
+        for (auto& p : speakerPositions)
+            p = glm::vec3(random.nextFloat(), random.nextFloat(), random.nextFloat()) * 10.0f;
+
+        // Long enough that the note doesn't end while it's being timed
+        AudioBuffer<float> samples(1, (numBlocks + 2) * blockSize);
+
+        for (int i = 0; i < samples.getNumSamples(); ++i)
+            samples.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+
+        SpatialSynth synth;
+        synth.setSampleRate(sampleRate);
+        synth.setVoicePool<SpatialSamplerVoice>(1);
+        synth.updateSpeakerPositions(speakerPositions);
+        synth.prepareRenderBuffers(numSpeakers, blockSize);
+
+        ReferenceCountedArray<SpatialSynthSound> sounds;
+        sounds.add(createSound(samples, sampleRate));
+        synth.setSounds(sounds);
+
+        AudioBuffer<float> output(numSpeakers, blockSize);
+        output.clear();
+
+        // The first block starts the note and ramps the gains up from silence, the rest are timed
+        std::vector<SoundEvent> events(1);
+        events[0].noteID = 1;
+        events[0].soundID = 0;
+        events[0].position = glm::vec3(5.0f);
+
+        synth.renderNextBlock(output, events, 0, blockSize);
+        events.clear();
+
+        const int64 startTime = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numBlocks; ++i)
+            synth.renderNextBlock(output, events, 0, blockSize);
+
+        const int64 endTime = Time::getHighResolutionTicks();
+
+        return Time::highResolutionTicksToSeconds(endTime - startTime) * 1.0e6 / numBlocks;
+    }
+
+    /** Makes a sound that plays the samples, by reading them back from an in memory wav file. */
+    static SpatialSynthSound* createSound(const AudioBuffer<float>& samples, double sampleRate)
+    {
+        WavAudioFormat wav;
+        MemoryBlock data;
+
+        {
+            std::unique_ptr<AudioFormatWriter> writer(wav.createWriterFor(new MemoryOutputStream(data, false),
+                                                                          sampleRate, 1, 32, {}, 0));
+            writer->writeFromAudioSampleBuffer(samples, 0, samples.getNumSamples());
+        }
+
+        std::unique_ptr<AudioFormatReader> reader(wav.createReaderFor(new MemoryInputStream(data, false), true));
+
+        return new SpatialSamplerSound("Benchmark", *reader, 0, 0.0, 0.1,
+                                       samples.getNumSamples() / sampleRate);
+    }
+};
+
+static SpatialSamplerVoiceBenchmark spatialSamplerVoiceBenchmark;
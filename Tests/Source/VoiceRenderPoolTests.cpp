@@ -0,0 +1,277 @@
+/*
+  ==============================================================================
+
+    VoiceRenderPoolTests.cpp
+    Created: 17 Oct 2026 6:31:27pm
+    Author:  Felix Faire
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/Audio/VoiceRenderPool.h"
+#include "common.hpp"
+
+namespace
+{
+    //==============================================================================
+    /** A voice that plays noise at a fixed position, without needing a synth or a sound. */
+    class BenchmarkVoice  : public SpatialSynthVoice
+    {
+    public:
+        BenchmarkVoice(const std::vector<glm::vec3>& speakerPositions,
+                       const glm::vec3& position,
+                       const AudioBuffer<float>& source)
+            : mSource(source)
+        {
+            setNumSpeakerOutputs((int)speakerPositions.size());
+            mPosition = position;
+            updateDBAPAmplitudes(speakerPositions);
+        }
+
+        bool canPlaySound(SpatialSynthSound*) override                                 { return false; }
+        void startNote(int, float, const glm::vec3&, SpatialSynthSound*) override      {}
+        void stopNote(float, bool) override                                            {}
+
+        /** Reads through the source like a sampler voice does, then mixes it into the speakers. */
+        void renderNextBlock(AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
+        {
+            prepareAmplitudeRamps(numSamples);
+
+            float* const mono = getMonoScratchBuffer();
+            const float* const source = mSource.getReadPointer(0);
+            const int sourceLength = mSource.getNumSamples() - 1;
+
+            while (numSamples > 0)
+            {
+                const int numThisTime = jmin(numSamples, getScratchBlockSize());
+
+                for (int i = 0; i < numThisTime; ++i)
+                {
+                    const auto pos = (int)mSourcePosition;
+                    const auto alpha = (float)(mSourcePosition - pos);
+                    mono[i] = source[pos] * (1.0f - alpha) + source[pos + 1] * alpha;
+
+                    mSourcePosition += 0.99;
+
+                    if (mSourcePosition >= sourceLength)
+                        mSourcePosition = 0.0;
+                }
+
+                addMonoToSpeakerChannels(mono, outputBuffer, startSample, numThisTime);
+
+                startSample += numThisTime;
+                numSamples -= numThisTime;
+            }
+        }
+
+        using SpatialSynthVoice::renderNextBlock;
+
+    private:
+        const AudioBuffer<float>&   mSource;
+        double                      mSourcePosition = 0.0;
+    };
+
+    //==============================================================================
+    /** A set of voices spread at random through the box around the speakers. */
+    struct VoiceSet
+    {
+        VoiceSet(const std::vector<glm::vec3>& speakerPositions, int numVoices)
+        {
+            // A fixed seed so that every set with the same arguments is the same
+            Random random(1234);
+            glm::vec3 min = speakerPositions[0];
+            glm::vec3 max = speakerPositions[0];
+
+            for (const auto& p : speakerPositions)
+            {
+                min = glm::min(min, p);
+                max = glm::max(max, p);
+            }
+
+            for (int i = 0; i < source.getNumSamples(); ++i)
+                source.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+
+            for (int i = 0; i < numVoices; ++i)
+            {
+                const glm::vec3 position = min + (max - min) * glm::vec3(random.nextFloat(), random.nextFloat(), random.nextFloat());
+                pointers.push_back(voices.add(new BenchmarkVoice(speakerPositions, position, source)));
+            }
+        }
+
+        AudioBuffer<float>              source { 1, 4096 };
+        OwnedArray<BenchmarkVoice>      voices;
+        std::vector<SpatialSynthVoice*> pointers;
+    };
+
+    std::vector<glm::vec3> createSpeakerPositions(int numSpeakers)
+    {
+        Random random(4321);
+        std::vector<glm::vec3> positions((size_t)numSpeakers);
+
+        for (auto& p : positions)
+            p = glm::vec3(random.nextFloat(), random.nextFloat(), random.nextFloat()) * 10.0f;
+
+        return positions;
+    }
+}
+
+//==============================================================================
+class VoiceRenderPoolTests  : public UnitTest
+{
+public:
+    VoiceRenderPoolTests() : UnitTest("VoiceRenderPool", "Audio") {}
+
+    void runTest() override
+    {
+        const auto speakerPositions = createSpeakerPositions(16);
+        const int numSpeakers = (int)speakerPositions.size();
+        const int blockSize = 256;
+        const int numVoices = 37;
+
+        beginTest("Matches serial rendering");
+        {
+            VoiceSet serialVoices(speakerPositions, numVoices);
+            VoiceSet pooledVoices(speakerPositions, numVoices);
+
+            VoiceRenderPool pool(3);
+            pool.prepare(numSpeakers, blockSize);
+
+            AudioBuffer<float> serial(numSpeakers, blockSize);
+            AudioBuffer<float> pooled(numSpeakers, blockSize);
+
+            for (int block = 0; block < 8; ++block)
+            {
+                serial.clear();
+                pooled.clear();
+
+                for (auto* voice : serialVoices.pointers)
+                    voice->renderNextBlock(serial, 0, blockSize);
+
+                expect(pool.render(pooledVoices.pointers, pooled, 0, blockSize));
+
+                for (int ch = 0; ch < numSpeakers; ++ch)
+                    for (int i = 0; i < blockSize; ++i)
+                        expectWithinAbsoluteError(pooled.getSample(ch, i), serial.getSample(ch, i), 1.0e-4f);
+            }
+        }
+
+        beginTest("Output doesn't depend on thread timing");
+        {
+            VoiceSet firstVoices(speakerPositions, numVoices);
+            VoiceSet secondVoices(speakerPositions, numVoices);
+
+            VoiceRenderPool pool(3);
+            pool.prepare(numSpeakers, blockSize);
+
+            AudioBuffer<float> first(numSpeakers, blockSize);
+            AudioBuffer<float> second(numSpeakers, blockSize);
+
+            for (int block = 0; block < 64; ++block)
+            {
+                first.clear();
+                second.clear();
+
+                pool.render(firstVoices.pointers, first, 0, blockSize);
+                pool.render(secondVoices.pointers, second, 0, blockSize);
+
+                bool isIdentical = true;
+
+                for (int ch = 0; ch < numSpeakers; ++ch)
+                    isIdentical = isIdentical && std::memcmp(first.getReadPointer(ch), second.getReadPointer(ch),
+                                                             sizeof(float) * (size_t)blockSize) == 0;
+
+                expect(isIdentical, "Block " + String(block) + " differs between runs");
+            }
+        }
+
+        beginTest("Rejects blocks larger than it was prepared for");
+        {
+            VoiceSet voices(speakerPositions, 4);
+            VoiceRenderPool pool(1);
+            pool.prepare(numSpeakers, blockSize);
+
+            AudioBuffer<float> output(numSpeakers, blockSize * 2);
+            expect(! pool.render(voices.pointers, output, 0, blockSize * 2));
+        }
+    }
+};
+
+static VoiceRenderPoolTests voiceRenderPoolTests;
+
+
+//==============================================================================
+/**
+    Shows how many voices a pool renders per millisecond with each number of
+    threads, so the speedup on the machine can be checked.
+*/
+class VoiceRenderPoolBenchmark  : public UnitTest
+{
+public:
+    VoiceRenderPoolBenchmark() : UnitTest("VoiceRenderPool throughput", "Benchmarks") {}
+
+    void runTest() override
+    {
+        const int maxNumThreads = jmax(2, SystemStats::getNumCpus());
+
+        for (int numSpeakers : { 16, 64 })
+        {
+            for (int blockSize : { 64, 512 })
+            {
+                const int numVoices = 128;
+
+                beginTest(String(numVoices) + " voices, " + String(numSpeakers) + " speakers, "
+                          + String(blockSize) + " sample blocks");
+
+                String message("Voices rendered per ms:");
+
+                for (int numThreads = 1; numThreads <= maxNumThreads; ++numThreads)
+                {
+                    const double voicesPerMs = measureVoicesPerMillisecond(createSpeakerPositions(numSpeakers),
+                                                                           numVoices, numThreads - 1, blockSize);
+                    expect(voicesPerMs > 0.0);
+
+                    message << (numThreads > 1 ? ", " : " ") << numThreads << " threads " << String(voicesPerMs, 1);
+                }
+
+                logMessage(message);
+            }
+        }
+    }
+
+private:
+    /** Times a pool with the given number of worker threads rendering numVoices
+        voices panned across the speakers, and returns how many voice blocks of
+        blockSize samples it renders per millisecond.
+    */
+    static double measureVoicesPerMillisecond(const std::vector<glm::vec3>& speakerPositions,
+                                              int numVoices,
+                                              int numWorkerThreads,
+                                              int blockSize)
+    {
+        const int numSpeakers = (int)speakerPositions.size();
+        const int numBlocks = 32;
+
+        VoiceSet voices(speakerPositions, numVoices);
+
+        VoiceRenderPool pool(numWorkerThreads);
+        pool.prepare(numSpeakers, blockSize);
+
+        AudioBuffer<float> output(numSpeakers, blockSize);
+        output.clear();
+
+        // The first block ramps the gains up from silence and wakes the workers
+        pool.render(voices.pointers, output, 0, blockSize);
+
+        const int64 startTime = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numBlocks; ++i)
+            pool.render(voices.pointers, output, 0, blockSize);
+
+        const double milliseconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTime) * 1000.0;
+
+        return milliseconds > 0.0 ? numVoices * numBlocks / milliseconds : 0.0;
+    }
+};
+
+static VoiceRenderPoolBenchmark voiceRenderPoolBenchmark;